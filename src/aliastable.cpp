@@ -0,0 +1,89 @@
+#include "aliastable.h"
+
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_reduce.h"
+
+#include <vector>
+
+bool BuildAliasTable(AliasTable& table, const float* weights, const uint32_t count) noexcept
+{
+    const double sum = tbb::parallel_reduce(tbb::blocked_range<uint32_t>(0, count), 0.0, [&](const tbb::blocked_range<uint32_t>& r, double partial)
+        {
+            for (uint32_t i = r.begin(), i_end = r.end(); i < i_end; i++) partial += weights[i];
+
+            return partial;
+        }, std::plus<double>());
+
+    if (!(sum > 0.0))
+    {
+        ReleaseAliasTable(table);
+        return false;
+    }
+
+    if (table.count != count)
+    {
+        ReleaseAliasTable(table);
+
+        table.entries = new AliasEntry[count];
+        table.count = count;
+    }
+
+    table.sum = sum;
+
+    // Shares scaled so the average slot is 1
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, count), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t i = r.begin(), i_end = r.end(); i < i_end; i++)
+            {
+                table.entries[i].probability = static_cast<float>(weights[i] / sum);
+                table.entries[i].threshold = static_cast<float>(weights[i] * count / sum);
+                table.entries[i].alias = i;
+            }
+        });
+
+    // Vose's pairing, each underfull slot is topped up by an overfull one. Linear and cheap next to the
+    // weights, it stays sequential
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+
+    small.reserve(count);
+    large.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (table.entries[i].threshold < 1.0f) small.push_back(i);
+        else large.push_back(i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        const uint32_t under = small.back();
+        const uint32_t over = large.back();
+
+        small.pop_back();
+
+        table.entries[under].alias = over;
+        table.entries[over].threshold -= 1.0f - table.entries[under].threshold;
+
+        if (table.entries[over].threshold < 1.0f)
+        {
+            large.pop_back();
+            small.push_back(over);
+        }
+    }
+
+    // What is left is only off by rounding
+    for (const uint32_t i : small) table.entries[i].threshold = 1.0f;
+    for (const uint32_t i : large) table.entries[i].threshold = 1.0f;
+
+    return true;
+}
+
+void ReleaseAliasTable(AliasTable& table) noexcept
+{
+    delete[] table.entries;
+    table.entries = nullptr;
+
+    table.count = 0;
+    table.sum = 0.0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "decl.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+// Walker alias table, draws an index with a probability proportional to its weight in constant time. Every slot
+// keeps a share of itself and gives the rest to its alias. The normalized probability of the entry is stored
+// along, so the pdf of a draw is a single lookup as well
+
+struct AliasEntry
+{
+    float threshold;   // Share of the slot kept by the entry
+    uint32_t alias;    // Index the rest of the slot goes to
+    float probability; // Of drawing the entry
+};
+
+struct AliasTable
+{
+    AliasEntry* entries = nullptr;
+    uint32_t count = 0;
+
+    double sum = 0.0; // Of the weights
+};
+
+// Releases the table and returns false if all the weights are zero
+bool BuildAliasTable(AliasTable& table, const float* weights, const uint32_t count) noexcept;
+
+void ReleaseAliasTable(AliasTable& table) noexcept;
+
+// u in [0, 1). What is left of u once the slot is picked is returned as a new uniform in [0, 1)
+FORCEINLINE uint32_t SampleAliasTable(const AliasTable& table, const float u, float& remaining) noexcept
+{
+    const float scaled = u * table.count;
+    const uint32_t index = std::min<uint32_t>(static_cast<uint32_t>(scaled), table.count - 1);
+    const float fraction = std::min(scaled - index, 0.99999994f);
+
+    const AliasEntry& entry = table.entries[index];
+
+    if (fraction < entry.threshold)
+    {
+        remaining = fraction / entry.threshold;
+        return index;
+    }
+
+    remaining = (fraction - entry.threshold) / (1.0f - entry.threshold);
+    return entry.alias;
+}
@@ -11,7 +11,6 @@
 
 #include "app.h"
 
-#define FLYTHROUGH_CAMERA_IMPLEMENTATION
 #include "flythrough_camera.h"
 
 // GLFW Callbacks and shortcuts handling
@@ -46,7 +45,7 @@ int application(int argc, char** argv)
     constexpr int xres = 1280;
     constexpr int yres = 720;
 
-    const uint32_t* blueNoisePtr = LoadBlueNoise();
+    const BlueNoise* blueNoisePtr = LoadBlueNoise();
 
     // Create window with graphics context
     GLFWwindow* window = glfwCreateWindow(xres, yres, "OceanTracer", NULL, NULL);
@@ -95,10 +94,34 @@ int application(int argc, char** argv)
     settings.yres = yres;
 
 
-    color* renderBuffer = new color[xres * yres];
+    int outputFormat = static_cast<int>(OutputFormat::RGBA8);
 
-    Tiles tiles;
-    GenerateTiles(tiles, settings);
+    // The renderer runs on its own thread, we only display its newest frame and push our edits to it
+    RenderThread renderThread;
+    ThreadSettings threadSettings;
+    StartRenderThread(renderThread, blueNoisePtr, threadSettings);
+
+    const int coreCount = tbb::info::default_concurrency();
+
+    RenderParams params;
+    GovernorSettings governorSettings;
+    PreviewSettings previewSettings;
+    TemporalSettings temporalSettings;
+    SparseSettings sparseSettings;
+    DenoiseSettings denoiseSettings;
+
+    // What the last displayed frame has been rendered with
+    Settings frameSettings = settings;
+    bool framePreview = false;
+
+    // The front slot of the frame ring stays valid until we acquire the next one
+    const Frame* displayedFrame = nullptr;
+
+    Warp warp;
+    WarpSettings warpSettings;
+    float warpTime = 0.0f;
+    float denoiseTime = 0.0f;
+    uint8_t frameGovernorLevels[GovernorKnob_Count] = { 0, 0, 0, 0 };
     
     GLuint render_view_texture;
 
@@ -110,7 +133,13 @@ int application(int argc, char** argv)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, xres, yres, 0, GL_RGB, GL_FLOAT, renderBuffer);
+    // Rows of RGB16F/RGB32F pixels are not always 4 bytes aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    OutputFormat textureOutputFormat = static_cast<OutputFormat>(outputFormat);
+    GLTextureFormat textureFormat = GetGLTextureFormat(textureOutputFormat);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, textureFormat.internalFormat, xres, yres, 0, textureFormat.format, textureFormat.type, nullptr);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -121,7 +150,9 @@ int application(int argc, char** argv)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     uint32_t samples = 1;
+    bool progressive = settings.progressive;
     bool edited = 0;
+    bool regionEdited = false;
     bool render = true;
     float elapsed = 0.0f;
     float renderSeconds = 0.0f;
@@ -134,6 +165,10 @@ int application(int argc, char** argv)
     double oldCursorX, oldCursorY;
     glfwGetCursorPos(window, &oldCursorX, &oldCursorY);
 
+    // Render region being dragged, in window coordinates
+    bool regionDragging = false;
+    double regionStartX = 0.0, regionStartY = 0.0;
+
     // Main loop
     while (!glfwWindowShouldClose(window))
     {
@@ -189,27 +224,63 @@ int application(int argc, char** argv)
         ImGui::NewFrame();
         ImGui::DockSpaceOverViewport(ImGui::GetMainViewport());
 
-        if(render)
+        // Upload the newest completed frame if the render thread produced one since last time
+        const FrameBuffer* upload = nullptr;
+
+        if (const Frame* frame = AcquireFrame(renderThread))
+        {
+            displayedFrame = frame;
+            upload = &frame->buffer;
+
+            elapsed = frame->renderTime;
+            denoiseTime = frame->denoiseTime;
+            samples = frame->samples;
+            frameSettings = frame->settings;
+            framePreview = frame->preview;
+
+            for (uint8_t i = 0; i < GovernorKnob_Count; i++) frameGovernorLevels[i] = frame->governorLevels[i];
+
+            if (!settings.progressive) renderSeconds += elapsed;
+        }
+
+        // Between two frames, reproject the last one to the current camera pose at display rate
+        if (warpSettings.enabled && displayedFrame != nullptr && displayedFrame->depth != nullptr)
         {
-            auto startRender = get_time();
+            const bool cameraMoved = !(displayedFrame->cam.pos == cam.pos) ||
+                                     memcmp(&displayedFrame->cam.transformation_matrix, &cam.transformation_matrix, sizeof(mat44)) != 0;
 
-            Render(renderBuffer, ocean, sky, blueNoisePtr, ImGui::GetFrameCount(), samples, tiles, cam, settings);
+            if (cameraMoved || upload != nullptr)
+            {
+                const auto startWarp = get_time();
 
-            auto endRender = get_time();
+                warp.settings = warpSettings;
+                WarpFrame(warp, *displayedFrame, cam, ocean, sky, blueNoisePtr, settings);
+                upload = &warp.output;
 
-            elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endRender - startRender).count();
-            renderSeconds += elapsed;
+                warpTime = std::chrono::duration<float, std::milli>(get_time() - startWarp).count();
+            }
+        }
 
+        if (upload != nullptr)
+        {
             glBindTexture(GL_TEXTURE_2D, render_view_texture);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, xres, yres, GL_RGB, GL_FLOAT, renderBuffer);
-            glBindTexture(GL_TEXTURE_2D, 0);
 
+            if (upload->format != textureOutputFormat)
+            {
+                textureOutputFormat = upload->format;
+                textureFormat = GetGLTextureFormat(textureOutputFormat);
+
+                glTexImage2D(GL_TEXTURE_2D, 0, textureFormat.internalFormat, xres, yres, 0, textureFormat.format, textureFormat.type, nullptr);
+            }
+
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, upload->xres, upload->yres, textureFormat.format, textureFormat.type, upload->data);
+            glBindTexture(GL_TEXTURE_2D, 0);
         }
         
         glBindFramebuffer(GL_READ_FRAMEBUFFER, myFbo);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // default fbo  
-        glBlitFramebuffer(0, 0, xres, yres,
-            0, display_h, display_w, 0, GL_COLOR_BUFFER_BIT, GL_LINEAR); // or GL_NEAREST
+        glBlitFramebuffer(0, 0, frameSettings.xres, frameSettings.yres,
+            0, display_h, display_w, 0, GL_COLOR_BUFFER_BIT, framePreview ? GL_NEAREST : GL_LINEAR);
 
         glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -221,20 +292,210 @@ int application(int argc, char** argv)
             ImGui::Text("FPS : %0.3f", ImGui::GetIO().Framerate);
             ImGui::Text("Frame time : %0.3f ms", elapsed);
             ImGui::Text("Render time : %0.1f s", renderSeconds / 1000.0f);
+            ImGui::Combo("Output", &outputFormat, "RGBA8\0RGB16F\0RGB32F\0");
+            if (ImGui::Checkbox("Progressive", &progressive)) edited = true;
+            if (settings.progressive) ImGui::Text("Samples : %u", samples);
+            int bounces = settings.bounces;
+            if (ImGui::SliderInt("Bounces", &bounces, 0, 8))
+            {
+                settings.bounces = bounces;
+                edited = true;
+            }
+            ImGui::Separator();
+            if (ImGui::SliderFloat("Speed", &ocean.speed, 0.0f, 10.0f)) edited = true;
+            if (ImGui::SliderFloat("Depth", &ocean.depth, 0.0f, 10.0f)) edited = true;
+            if (ImGui::SliderFloat("Phase", &ocean.phase, 0.0f, 20.0f)) edited = true;
+            ImGui::Separator();
+            ImGui::Checkbox("Frame extrapolation", &warpSettings.enabled);
+            if (warpSettings.enabled) ImGui::Text("Warp time : %0.3f ms", warpTime);
+            ImGui::Checkbox("Temporal accumulation", &temporalSettings.enabled);
+            if (temporalSettings.enabled) ImGui::SliderFloat("Temporal blend", &temporalSettings.blend, 0.02f, 1.0f);
+            // The render thread ignores it while path tracing
+            const bool sparseAvailable = settings.bounces == 0;
+            if (!sparseAvailable) ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f);
+            ImGui::Checkbox("Sparse rendering", &sparseSettings.enabled);
+            if (!sparseAvailable)
+            {
+                ImGui::PopStyleVar();
+                ImGui::SameLine();
+                ImGui::TextDisabled("(off with bounces)");
+            }
+            if (sparseSettings.enabled && sparseAvailable)
+            {
+                int stride = sparseSettings.stride;
+                if (ImGui::SliderInt("Sparse stride", &stride, 1, 4)) sparseSettings.stride = stride;
+                ImGui::SliderFloat("Sparse normal threshold", &sparseSettings.normalThreshold, 0.5f, 1.0f);
+            }
+            ImGui::Checkbox("Denoise", &denoiseSettings.enabled);
+            if (denoiseSettings.enabled)
+            {
+                int iterations = denoiseSettings.iterations;
+                if (ImGui::SliderInt("Denoise iterations", &iterations, 1, 5)) denoiseSettings.iterations = iterations;
+                ImGui::SliderFloat("Denoise color sigma", &denoiseSettings.colorSigma, 0.05f, 2.0f);
+                ImGui::Text("Denoise time : %0.3f ms", denoiseTime);
+            }
+            if (HasRenderRegion(settings))
+            {
+                ImGui::Text("Region : %u %u - %u %u", settings.region.x_start, settings.region.y_start, settings.region.x_end, settings.region.y_end);
+                if (ImGui::Button("Clear region"))
+                {
+                    settings.region = RenderRegion();
+                    regionEdited = true;
+                }
+            }
+            else
+            {
+                ImGui::Text("Region : alt + left drag to render a region");
+            }
+            ImGui::Separator();
+            ImGui::Checkbox("Motion preview", &previewSettings.enabled);
+            if (previewSettings.enabled)
+            {
+                ImGui::SliderFloat("Preview scale", &previewSettings.resolutionScale, 0.1f, 1.0f);
+                ImGui::Text("Preview : %s", framePreview ? "on" : "off");
+            }
             ImGui::Separator();
-            ImGui::SliderFloat("Speed", &ocean.speed, 0.0f, 10.0f);
-            ImGui::SliderFloat("Depth", &ocean.depth, 0.0f, 10.0f);
-            ImGui::SliderFloat("Phase", &ocean.phase, 0.0f, 20.0f);
+            {
+                // Only applied on demand, the thread pools live as long as the render thread
+                int renderThreads = threadSettings.renderThreads;
+                int denoiseThreads = threadSettings.denoiseThreads;
+                int firstCore = threadSettings.firstCore;
+
+                if (ImGui::SliderInt("Render threads", &renderThreads, 0, coreCount, renderThreads == 0 ? "all cores" : "%d")) threadSettings.renderThreads = renderThreads;
+                if (ImGui::SliderInt("Denoise threads", &denoiseThreads, 0, coreCount, denoiseThreads == 0 ? "render ones" : "%d")) threadSettings.denoiseThreads = denoiseThreads;
+                ImGui::Checkbox("Pin threads", &threadSettings.pin);
+                if (threadSettings.pin && ImGui::SliderInt("First core", &firstCore, 0, coreCount - 1)) threadSettings.firstCore = firstCore;
+
+                if (ImGui::Button("Apply threads"))
+                {
+                    RestartRenderThread(renderThread, threadSettings);
+
+                    // Its frames went away with it
+                    displayedFrame = nullptr;
+                }
+            }
+            ImGui::Separator();
+            ImGui::Checkbox("Governor", &governorSettings.enabled);
+            if (governorSettings.enabled)
+            {
+                ImGui::SliderFloat("Target (ms)", &governorSettings.targetFrameTime, 5.0f, 200.0f);
+                ImGui::SliderFloat("Hysteresis", &governorSettings.hysteresis, 0.0f, 0.5f);
+
+                // Degradation order, picking a knob already used in another slot swaps them
+                for (uint8_t i = 0; i < GovernorKnob_Count; i++)
+                {
+                    int knob = governorSettings.priority[i];
+                    ImGui::PushID(i);
+                    if (ImGui::Combo("Degrade", &knob, governorKnobNames, GovernorKnob_Count))
+                    {
+                        for (uint8_t j = 0; j < GovernorKnob_Count; j++)
+                        {
+                            if (governorSettings.priority[j] == knob) governorSettings.priority[j] = governorSettings.priority[i];
+                        }
+
+                        governorSettings.priority[i] = knob;
+                    }
+                    ImGui::PopID();
+                }
+
+                for (uint8_t i = 0; i < GovernorKnob_Count; i++)
+                {
+                    const uint8_t level = frameGovernorLevels[i];
+                    ImGui::Text("%s%s : level %u (x%0.2f)", level > 0 ? "* " : "  ", governorKnobNames[i], level, governorLadder[i][level]);
+                }
+
+                ImGui::Text("Resolution : %ux%u", frameSettings.xres, frameSettings.yres);
+                ImGui::Text("Octaves : %u raymarch, %u normal", frameSettings.raymarchOctaves, frameSettings.normalOctaves);
+                ImGui::Text("March steps : %u", frameSettings.maxMarchSteps);
+            }
 
             ImGui::End();
         }
         ImGui::PopStyleColor();
 
+        // Alt + left drag selects the render region over the view, an alt click clears it
+        {
+            int windowWidth, windowHeight;
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+
+            const bool selecting = glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS &&
+                                   glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+
+            const auto toPixel = [](const double coord, const int size, const uint16_t res) -> uint16_t
+                {
+                    return static_cast<uint16_t>(std::clamp(coord / std::max(size, 1) * res, 0.0, static_cast<double>(res)));
+                };
+
+            const auto toWindow = [](const uint16_t pixel, const int size, const uint16_t res) -> float
+                {
+                    return static_cast<float>(pixel) * size / res;
+                };
+
+            if (selecting && !regionDragging)
+            {
+                regionDragging = true;
+                regionStartX = cursorX;
+                regionStartY = cursorY;
+            }
+
+            RenderRegion region = settings.region;
+
+            if (regionDragging)
+            {
+                region.x_start = toPixel(std::min(regionStartX, cursorX), windowWidth, xres);
+                region.y_start = toPixel(std::min(regionStartY, cursorY), windowHeight, yres);
+                region.x_end = toPixel(std::max(regionStartX, cursorX), windowWidth, xres);
+                region.y_end = toPixel(std::max(regionStartY, cursorY), windowHeight, yres);
+
+                if (!selecting)
+                {
+                    regionDragging = false;
+
+                    settings.region = region;
+                    regionEdited = true;
+                }
+            }
+
+            if (region.x_end > region.x_start && region.y_end > region.y_start)
+            {
+                const ImVec2 origin = ImGui::GetMainViewport()->Pos;
+
+                ImGui::GetForegroundDrawList()->AddRect(
+                    ImVec2(origin.x + toWindow(region.x_start, windowWidth, xres), origin.y + toWindow(region.y_start, windowHeight, yres)),
+                    ImVec2(origin.x + toWindow(region.x_end, windowWidth, xres), origin.y + toWindow(region.y_end, windowHeight, yres)),
+                    IM_COL32(255, 200, 0, 255));
+            }
+        }
+
         ocean.bbox.p0.y = -ocean.depth;
 
+        settings.progressive = progressive;
+
         if (render)
         {
-            settings.time = renderSeconds / 1000.0f;
+            // Progressive renders accumulate a still frame, so time only moves forward otherwise
+            if (!settings.progressive) settings.time = renderSeconds / 1000.0f;
+
+            params.cam = cam;
+            params.ocean = ocean;
+            params.sky = sky;
+            params.settings = settings;
+            params.format = static_cast<OutputFormat>(outputFormat);
+            params.governor = governorSettings;
+            params.preview = previewSettings;
+            params.temporal = temporalSettings;
+            params.sparse = sparseSettings;
+            params.denoise = denoiseSettings;
+            params.outputDepth = warpSettings.enabled;
+            params.moving = edited;
+            
+            // The accumulation of the tiles entering the region would be stale
+            if (edited || regionEdited) params.version++;
+
+            regionEdited = false;
+
+            PushRenderParams(renderThread, params);
+
             oldCursorX = cursorX;
             oldCursorY = cursorY;
         }
@@ -246,9 +507,8 @@ int application(int argc, char** argv)
         glfwSwapBuffers(window);
     }
 
-    ReleaseTiles(tiles);
-
-    delete[] renderBuffer;
+    StopRenderThread(renderThread);
+    ReleaseWarp(warp);
 
     // Cleanup
     ImGui_ImplOpenGL3_Shutdown();
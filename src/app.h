@@ -1,6 +1,8 @@
 #pragma once
 
 #include "render.h"
+#include "renderthread.h"
+#include "warp.h"
 #include "glutils.h"
 
 #include <chrono>
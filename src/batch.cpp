@@ -0,0 +1,325 @@
+#include "batch.h"
+
+#include "flythrough_camera.h"
+
+void InitBatchRenderer(BatchRenderer& renderer, const BatchScene& scene, const bool progressive) noexcept
+{
+    renderer.blueNoise = LoadBlueNoise();
+
+    renderer.ocean.depth = scene.ocean.depth;
+    renderer.ocean.phase = scene.ocean.phase;
+    renderer.ocean.speed = scene.ocean.speed;
+    renderer.ocean.drag = scene.ocean.drag;
+    renderer.ocean.albedo = scene.ocean.albedo;
+    renderer.ocean.ior = scene.ocean.ior;
+    renderer.ocean.bbox = BoundingBox(vec3(-100.0f, -renderer.ocean.depth, -100.0f), vec3(100.0f, 0.0f, 100.0f));
+
+    UpdateEnvMap(renderer.envMap, renderer.sky);
+    renderer.sky.envMap = &renderer.envMap;
+
+    renderer.settings.xres = scene.xres;
+    renderer.settings.yres = scene.yres;
+    renderer.settings.progressive = progressive;
+    renderer.settings.raymarchOctaves = scene.raymarchOctaves;
+    renderer.settings.normalOctaves = scene.normalOctaves;
+    renderer.settings.maxMarchSteps = scene.maxMarchSteps;
+    renderer.settings.bounces = scene.bounces;
+    renderer.settings.region = scene.region;
+
+    renderer.cam = Camera(vec3(0.0f), vec3(0.0f), scene.focalLength, scene.xres, scene.yres);
+
+    InitNumaTopology(renderer.numa);
+
+    renderer.tiles.numa = &renderer.numa;
+    GenerateTiles(renderer.tiles, renderer.settings);
+
+    AllocateAOVs(renderer.aovs, scene.xres, scene.yres);
+    AllocateFrameBuffer(renderer.buffer, scene.xres, scene.yres, OutputFormat::RGBA8, &renderer.numa);
+}
+
+void ReleaseBatchRenderer(BatchRenderer& renderer) noexcept
+{
+    for (BatchView& view : renderer.views)
+    {
+        ReleaseAOVs(view.aovs);
+        ReleaseRayCache(view.rayCache);
+    }
+
+    renderer.views.clear();
+
+    ReleaseFrameBuffer(renderer.buffer);
+    ReleaseAOVs(renderer.aovs);
+    ReleaseRayCache(renderer.rayCache);
+    ReleaseTiles(renderer.tiles);
+    ReleaseEnvMap(renderer.envMap);
+}
+
+// Cameras move along the scene velocity, with the same view convention as the interactive flythrough camera
+static void SetBatchCamera(Camera& cam, const BatchScene& scene, const float* eye, const float* look, const float elapsed) noexcept
+{
+    const float position[3] = { eye[0] + scene.velocity[0] * elapsed,
+                                eye[1] + scene.velocity[1] * elapsed,
+                                eye[2] + scene.velocity[2] * elapsed };
+
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+    float view[16];
+    flythrough_camera_look_to(position, look, up, view, 0);
+
+    cam.pos = vec3(position[0], position[1], position[2]);
+    cam.SetTransformFromCam(mat44(view[0], view[1], view[2], view[3],
+        view[4], view[5], view[6], view[7],
+        view[8], view[9], view[10], view[11],
+        view[12], view[13], view[14], view[15]));
+}
+
+void SetBatchFrame(BatchRenderer& renderer, const BatchScene& scene, const uint32_t frame) noexcept
+{
+    const float elapsed = frame * scene.timeStep;
+
+    renderer.settings.time = scene.startTime + elapsed;
+
+    SetBatchCamera(renderer.cam, scene, scene.eye, scene.look, elapsed);
+
+    for (BatchView& view : renderer.views) SetBatchCamera(view.cam, scene, view.eye, view.look, elapsed);
+}
+
+void AddBatchView(BatchRenderer& renderer, const BatchScene& scene, const float* eye, const float* look) noexcept
+{
+    BatchView& view = renderer.views.emplace_back();
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        view.eye[i] = eye[i];
+        view.look[i] = look[i];
+    }
+
+    view.cam = Camera(vec3(0.0f), vec3(0.0f), scene.focalLength, scene.xres, scene.yres);
+
+    AllocateAOVs(view.aovs, scene.xres, scene.yres);
+}
+
+// Blends the sample rendered to the AOVs into the accumulated rows, the first sample overwrites them
+static void AccumulateBatchRows(const AOVs& aovs, const uint16_t yStart, const uint16_t yEnd, const uint32_t sample, float* beauty) noexcept
+{
+    const uint32_t xres = aovs.xres;
+    const float weight = 1.0f / static_cast<float>(sample);
+
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(yStart, yEnd), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (uint32_t x = 0; x < xres; x++)
+                {
+                    const uint32_t index = x + y * xres;
+
+                    float* pixel = beauty + (x + (y - yStart) * xres) * 3;
+
+                    pixel[0] = sample == 1 ? aovs.beauty[index].R : maths::lerp(pixel[0], aovs.beauty[index].R, weight);
+                    pixel[1] = sample == 1 ? aovs.beauty[index].G : maths::lerp(pixel[1], aovs.beauty[index].G, weight);
+                    pixel[2] = sample == 1 ? aovs.beauty[index].B : maths::lerp(pixel[2], aovs.beauty[index].B, weight);
+                }
+            }
+        });
+}
+
+// Normal and depth of the last sample rendered to the AOVs
+static void CopyBatchLayers(const AOVs& aovs, const uint16_t yStart, const uint16_t yEnd, float* normal, float* depth) noexcept
+{
+    const uint32_t xres = aovs.xres;
+
+    for (uint32_t y = yStart; y < yEnd; y++)
+    {
+        for (uint32_t x = 0; x < xres; x++)
+        {
+            const uint32_t index = x + y * xres;
+            const uint32_t row = x + (y - yStart) * xres;
+
+            if (normal != nullptr)
+            {
+                normal[row * 3 + 0] = aovs.normal[index].x;
+                normal[row * 3 + 1] = aovs.normal[index].y;
+                normal[row * 3 + 2] = aovs.normal[index].z;
+            }
+
+            if (depth != nullptr) depth[row] = aovs.depth[index];
+        }
+    }
+}
+
+void RenderBatchRows(BatchRenderer& renderer,
+                     const BatchScene& scene,
+                     const uint16_t yStart,
+                     const uint16_t yEnd,
+                     float* beauty,
+                     float* normal,
+                     float* depth) noexcept
+{
+    // Only the tiles overlapping the rows
+    Tiles band;
+    band.numa = renderer.tiles.numa;
+
+    for (const Tile& tile : renderer.tiles.tiles)
+    {
+        if (tile.y_end > yStart && tile.y_start < yEnd) band.tiles.push_back(tile);
+    }
+
+    band.count = band.tiles.size();
+
+    for (uint32_t sample = 1; sample <= scene.samples; sample++)
+    {
+        UpdateRayCache(renderer.rayCache, renderer.cam, renderer.settings.xres, renderer.settings.yres, renderer.blueNoise, sample);
+        renderer.cam.rayCache = &renderer.rayCache;
+
+        Render(renderer.buffer, renderer.ocean, renderer.sky, renderer.blueNoise, 0, sample, band, renderer.cam, renderer.settings, &renderer.aovs);
+
+        AccumulateBatchRows(renderer.aovs, yStart, yEnd, sample, beauty);
+    }
+
+    CopyBatchLayers(renderer.aovs, yStart, yEnd, normal, depth);
+}
+
+void RenderBatchViews(BatchRenderer& renderer,
+                      const BatchScene& scene,
+                      float* const* beauty,
+                      float* const* normal,
+                      float* const* depth) noexcept
+{
+    const uint32_t viewCount = 1 + renderer.views.size();
+
+    // The main camera is the first view, all of them share the tiles since nothing accumulates in them
+    std::vector<RenderView> views(viewCount);
+
+    views[0].buffer = &renderer.buffer;
+    views[0].tiles = &renderer.tiles;
+    views[0].aovs = &renderer.aovs;
+
+    for (uint32_t v = 1; v < viewCount; v++)
+    {
+        views[v].buffer = &renderer.buffer;
+        views[v].tiles = &renderer.tiles;
+        views[v].aovs = &renderer.views[v - 1].aovs;
+    }
+
+    for (uint32_t sample = 1; sample <= scene.samples; sample++)
+    {
+        UpdateRayCache(renderer.rayCache, renderer.cam, renderer.settings.xres, renderer.settings.yres, renderer.blueNoise, sample);
+        renderer.cam.rayCache = &renderer.rayCache;
+        views[0].cam = renderer.cam;
+
+        for (uint32_t v = 1; v < viewCount; v++)
+        {
+            BatchView& view = renderer.views[v - 1];
+
+            UpdateRayCache(view.rayCache, view.cam, renderer.settings.xres, renderer.settings.yres, renderer.blueNoise, sample);
+            view.cam.rayCache = &view.rayCache;
+            views[v].cam = view.cam;
+        }
+
+        RenderViews(views.data(), viewCount, renderer.ocean, renderer.sky, renderer.blueNoise, 0, sample, renderer.settings);
+
+        for (uint32_t v = 0; v < viewCount; v++) AccumulateBatchRows(*views[v].aovs, 0, renderer.settings.yres, sample, beauty[v]);
+    }
+
+    for (uint32_t v = 0; v < viewCount; v++)
+    {
+        CopyBatchLayers(*views[v].aovs, 0, renderer.settings.yres, normal != nullptr ? normal[v] : nullptr, depth != nullptr ? depth[v] : nullptr);
+    }
+}
+
+void RenderBatchTiles(BatchRenderer& renderer,
+                      const BatchScene& scene,
+                      uint32_t* tileSamples,
+                      const std::function<void()>& onPass) noexcept
+{
+    std::vector<Tile*> pending;
+
+    WaveTable waves;
+    const Ocean frameOcean = PrepareFrameOcean(renderer.ocean, waves, renderer.settings);
+
+    while (true)
+    {
+        pending.clear();
+
+        uint32_t sample = scene.samples;
+
+        for (Tile& tile : renderer.tiles.tiles)
+        {
+            if (tileSamples[tile.id] >= scene.samples || !IsTileInRegion(tile, renderer.settings)) continue;
+
+            pending.push_back(&tile);
+            sample = maths::min(sample, tileSamples[tile.id] + 1);
+        }
+
+        if (pending.empty()) break;
+
+        // Tiles resumed at another sample than the lowest one miss the cache and compute their own directions
+        UpdateRayCache(renderer.rayCache, renderer.cam, renderer.settings.xres, renderer.settings.yres, renderer.blueNoise, sample);
+        renderer.cam.rayCache = &renderer.rayCache;
+
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, pending.size(), 1), [&](const tbb::blocked_range<size_t>& r)
+            {
+                for (size_t t = r.begin(), t_end = r.end(); t < t_end; t++)
+                {
+                    Tile& tile = *pending[t];
+
+                    RenderTile(renderer.buffer, frameOcean, renderer.sky, renderer.blueNoise, 0, tileSamples[tile.id] + 1,
+                               tile, renderer.cam, renderer.settings);
+
+                    // Counted once the pixels hold it, a checkpoint taken in between only misses this sample
+                    tileSamples[tile.id]++;
+                }
+            });
+
+        onPass();
+    }
+}
+
+void RenderBatchLayers(BatchRenderer& renderer, float* normal, float* depth) noexcept
+{
+    UpdateRayCache(renderer.rayCache, renderer.cam, renderer.settings.xres, renderer.settings.yres, renderer.blueNoise, 1);
+    renderer.cam.rayCache = &renderer.rayCache;
+
+    // The beauty goes to its AOV plane, leaving the accumulation of the tiles alone
+    Render(renderer.buffer, renderer.ocean, renderer.sky, renderer.blueNoise, 0, 1, renderer.tiles, renderer.cam, renderer.settings, &renderer.aovs);
+
+    CopyBatchLayers(renderer.aovs, 0, renderer.settings.yres, normal, depth);
+}
+
+void GatherBatchTiles(const BatchRenderer& renderer, float* beauty) noexcept
+{
+    const uint32_t xres = renderer.settings.xres;
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, renderer.tiles.tiles.size()), [&](const tbb::blocked_range<size_t>& r)
+        {
+            for (size_t t = r.begin(), t_end = r.end(); t < t_end; t++)
+            {
+                const Tile& tile = renderer.tiles.tiles[t];
+
+                for (uint32_t y = tile.y_start; y < tile.y_end; y++)
+                {
+                    for (uint32_t x = tile.x_start; x < tile.x_end; x++)
+                    {
+                        const color& pixel = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_x];
+
+                        float* output = beauty + (x + y * xres) * 3;
+
+                        output[0] = pixel.R;
+                        output[1] = pixel.G;
+                        output[2] = pixel.B;
+                    }
+                }
+            }
+        });
+}
+
+void RenderBatchFrame(BatchRenderer& renderer, const BatchScene& scene, FrameBuffer& buffer) noexcept
+{
+    for (uint32_t sample = 1; sample <= scene.samples; sample++)
+    {
+        UpdateRayCache(renderer.rayCache, renderer.cam, renderer.settings.xres, renderer.settings.yres, renderer.blueNoise, sample);
+        renderer.cam.rayCache = &renderer.rayCache;
+
+        Render(buffer, renderer.ocean, renderer.sky, renderer.blueNoise, 0, sample, renderer.tiles, renderer.cam, renderer.settings);
+    }
+}
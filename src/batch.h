@@ -0,0 +1,125 @@
+#pragma once
+
+#include "render.h"
+#include "raycache.h"
+
+#include <functional>
+
+// Offline rendering of animation frames, shared by the headless renderer and the distributed workers
+
+// Parameters of the ocean, without the process local state of Ocean like its wave table. Same defaults
+struct BatchOcean
+{
+    float depth = 2.0f;
+    float phase = 6.0f;
+    float speed = 2.0f;
+    float drag = 0.048f;
+
+    vec3 albedo = vec3(0.02f, 0.06f, 0.08f);
+    float ior = 1.33f;
+};
+
+// Everything that defines the frames of a sequence. Plain data without any pointer, the coordinator sends it
+// to the workers as is so they all render exactly the same frames, and the checkpoints store it
+struct BatchScene
+{
+    uint16_t xres = 1280;
+    uint16_t yres = 720;
+
+    float startTime = 0.0f;
+    float timeStep = 1.0f / 30.0f;
+    uint32_t samples = 1;
+
+    float eye[3] = { 0.0f, 0.0f, 0.0f };
+    float look[3] = { 0.0f, 0.0f, 1.0f };
+    float velocity[3] = { 0.0f, 0.0f, 0.0f }; // Camera translation per second
+    float focalLength = 50.0f;
+
+    BatchOcean ocean;
+
+    uint8_t raymarchOctaves = ITERATIONS_RAYMARCH;
+    uint8_t normalOctaves = ITERATIONS_NORMAL;
+    uint16_t maxMarchSteps = MAX_RAYMARCH_STEPS;
+    uint8_t bounces = 0; // Path traced when set
+
+    // Pixels outside of it stay black
+    RenderRegion region;
+};
+
+// Additional camera of a multi view render, it moves along the scene velocity like the main one
+struct BatchView
+{
+    float eye[3];
+    float look[3];
+
+    Camera cam;
+    RayCache rayCache;
+    AOVs aovs;
+};
+
+struct BatchRenderer
+{
+    const BlueNoise* blueNoise = nullptr;
+
+    NumaTopology numa;
+
+    Sky sky;
+    EnvMap envMap;
+    Ocean ocean;
+    Settings settings;
+    Camera cam;
+
+    Tiles tiles;
+    RayCache rayCache;
+    AOVs aovs;
+    FrameBuffer buffer;
+
+    std::vector<BatchView> views;
+};
+
+// Progressive renderers accumulate the samples in the tiles and can only render whole frames with RenderBatchFrame
+void InitBatchRenderer(BatchRenderer& renderer, const BatchScene& scene, const bool progressive) noexcept;
+
+void ReleaseBatchRenderer(BatchRenderer& renderer) noexcept;
+
+// Adds a camera rendered by RenderBatchViews along with the main one
+void AddBatchView(BatchRenderer& renderer, const BatchScene& scene, const float* eye, const float* look) noexcept;
+
+// Moves the time and the cameras to the given frame
+void SetBatchFrame(BatchRenderer& renderer, const BatchScene& scene, const uint32_t frame) noexcept;
+
+// Renders the rows [yStart, yEnd) of the current frame with all the samples of the scene. beauty gets interleaved
+// linear RGB rows, normal (RGB) and depth are optional
+void RenderBatchRows(BatchRenderer& renderer,
+                     const BatchScene& scene,
+                     const uint16_t yStart,
+                     const uint16_t yEnd,
+                     float* beauty,
+                     float* normal,
+                     float* depth) noexcept;
+
+// Renders the whole current frame from the main camera and every added view, sharing the per frame setup and
+// scheduling all their tiles together. The arrays hold one image per view, the main camera first, and have
+// the same layout as the RenderBatchRows ones. normal and depth are optional
+void RenderBatchViews(BatchRenderer& renderer,
+                      const BatchScene& scene,
+                      float* const* beauty,
+                      float* const* normal,
+                      float* const* depth) noexcept;
+
+// Progressive render of the whole current frame where every tile continues from its own count in tileSamples, up to
+// the samples of the scene. Calls back after each pass over the tiles, which is when the counts are up to date
+void RenderBatchTiles(BatchRenderer& renderer,
+                      const BatchScene& scene,
+                      uint32_t* tileSamples,
+                      const std::function<void()>& onPass) noexcept;
+
+// Renders a single sample of the current frame for the normal (RGB) and depth layers
+void RenderBatchLayers(BatchRenderer& renderer, float* normal, float* depth) noexcept;
+
+// Copies the accumulation of the progressive tiles to interleaved linear RGB rows
+void GatherBatchTiles(const BatchRenderer& renderer, float* beauty) noexcept;
+
+// Renders the whole current frame and resolves it into the buffer format, needs a progressive renderer if the
+// scene has more than one sample
+void RenderBatchFrame(BatchRenderer& renderer, const BatchScene& scene, FrameBuffer& buffer) noexcept;
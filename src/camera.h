@@ -2,12 +2,19 @@
 
 #include "mat44.h"
 
+#include <stdint.h>
+
+struct RayCache;
+
 struct Camera
 {
 	mat44 transformation_matrix;
 	
 	vec3 pos;
 
+	// Primary ray directions of this pose when set, the renderer falls back to generating them if it does not match
+	const RayCache* rayCache = nullptr;
+
 	float focal_length;
 	float fov;
 	float aspect;
@@ -32,4 +39,27 @@ struct Camera
 	
 	void SetTransformFromCam(const mat44& rotate_matrix) noexcept;
 
-};
\ No newline at end of file
+};
+
+// Inverse of the primary ray generation, maps a world position to continuous pixel coordinates.
+// inverseMatrix is inverse_linear(transformation_matrix), computed once per frame by the caller
+FORCEINLINE bool ProjectToScreen(const Camera& cam, 
+								 const mat44& inverseMatrix, 
+								 const vec3& position, 
+								 const uint32_t xres, 
+								 const uint32_t yres, 
+								 float& px, 
+								 float& py) noexcept
+{
+	const vec3 local = transform_dir(position - cam.pos, inverseMatrix);
+
+	if (local.z >= 0.0f) return false;
+
+	const float xScreen = local.x / -local.z;
+	const float yScreen = local.y / -local.z;
+
+	px = (xScreen / (cam.aspect * cam.scale) + 1.0f) * 0.5f * xres;
+	py = (1.0f - yScreen / cam.scale) * 0.5f * yres;
+
+	return true;
+}
\ No newline at end of file
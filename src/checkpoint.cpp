@@ -0,0 +1,230 @@
+#include "checkpoint.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static constexpr uint32_t checkpointMagic = 0x4B43544F; // "OTCK"
+static constexpr uint32_t checkpointVersion = 3;
+
+static constexpr uint32_t noFrame = ~0u;
+
+// The tile buffers start on a cache line, after the header and the sample counts
+FORCEINLINE size_t PixelsOffset(const uint32_t tileCount) noexcept
+{
+    return (sizeof(CheckpointHeader) + tileCount * sizeof(uint32_t) + 63) & ~static_cast<size_t>(63);
+}
+
+static bool SameScene(const BatchScene& a, const BatchScene& b) noexcept
+{
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        if (a.eye[i] != b.eye[i] || a.look[i] != b.look[i] || a.velocity[i] != b.velocity[i]) return false;
+    }
+
+    return a.xres == b.xres && a.yres == b.yres &&
+           a.startTime == b.startTime && a.timeStep == b.timeStep && a.samples == b.samples &&
+           a.focalLength == b.focalLength &&
+           a.ocean.depth == b.ocean.depth && a.ocean.phase == b.ocean.phase &&
+           a.ocean.speed == b.ocean.speed && a.ocean.drag == b.ocean.drag &&
+           a.ocean.albedo.x == b.ocean.albedo.x && a.ocean.albedo.y == b.ocean.albedo.y &&
+           a.ocean.albedo.z == b.ocean.albedo.z && a.ocean.ior == b.ocean.ior &&
+           a.raymarchOctaves == b.raymarchOctaves && a.normalOctaves == b.normalOctaves &&
+           a.maxMarchSteps == b.maxMarchSteps && a.bounces == b.bounces &&
+           a.region.x_start == b.region.x_start && a.region.y_start == b.region.y_start &&
+           a.region.x_end == b.region.x_end && a.region.y_end == b.region.y_end;
+}
+
+#ifdef _MSC_VER
+
+static bool MapFile(Checkpoint& checkpoint, const char* path, const size_t size, bool& existed) noexcept
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    existed = GetFileSizeEx(file, &fileSize) && static_cast<size_t>(fileSize.QuadPart) == size;
+
+    HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+
+    if (fileMapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    checkpoint.mapping = MapViewOfFile(fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+    if (checkpoint.mapping == nullptr)
+    {
+        CloseHandle(fileMapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    checkpoint.file = file;
+    checkpoint.fileMapping = fileMapping;
+
+    return true;
+}
+
+static void FlushMapping(Checkpoint& checkpoint, const bool wait) noexcept
+{
+    FlushViewOfFile(checkpoint.mapping, checkpoint.size);
+
+    if (wait) FlushFileBuffers(checkpoint.file);
+}
+
+static void UnmapFile(Checkpoint& checkpoint) noexcept
+{
+    UnmapViewOfFile(checkpoint.mapping);
+    CloseHandle(checkpoint.fileMapping);
+    CloseHandle(checkpoint.file);
+
+    checkpoint.file = nullptr;
+    checkpoint.fileMapping = nullptr;
+}
+
+#else
+
+static bool MapFile(Checkpoint& checkpoint, const char* path, const size_t size, bool& existed) noexcept
+{
+    const int file = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (file < 0) return false;
+
+    struct stat status;
+    existed = fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) == size;
+
+    if (!existed && ftruncate(file, size) != 0)
+    {
+        close(file);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        close(file);
+        return false;
+    }
+
+    checkpoint.mapping = mapping;
+    checkpoint.file = file;
+
+    return true;
+}
+
+static void FlushMapping(Checkpoint& checkpoint, const bool wait) noexcept
+{
+    msync(checkpoint.mapping, checkpoint.size, wait ? MS_SYNC : MS_ASYNC);
+}
+
+static void UnmapFile(Checkpoint& checkpoint) noexcept
+{
+    munmap(checkpoint.mapping, checkpoint.size);
+    close(checkpoint.file);
+
+    checkpoint.file = -1;
+}
+
+#endif
+
+bool OpenCheckpoint(Checkpoint& checkpoint, const char* path, const BatchScene& scene, Tiles& tiles, const bool resume, bool& resumed) noexcept
+{
+    const uint32_t tileCount = tiles.tiles.size();
+
+    size_t pixelCount = 0;
+    for (const Tile& tile : tiles.tiles) pixelCount += tile.size_x * tile.size_y;
+
+    checkpoint.size = PixelsOffset(tileCount) + pixelCount * sizeof(color);
+
+    bool existed = false;
+
+    if (!MapFile(checkpoint, path, checkpoint.size, existed)) return false;
+
+    checkpoint.header = static_cast<CheckpointHeader*>(checkpoint.mapping);
+    checkpoint.tileSamples = reinterpret_cast<uint32_t*>(checkpoint.header + 1);
+
+    CheckpointHeader& header = *checkpoint.header;
+
+    resumed = resume && existed &&
+              header.magic == checkpointMagic &&
+              header.version == checkpointVersion &&
+              header.tileCount == tileCount &&
+              SameScene(header.scene, scene);
+
+    if (!resumed)
+    {
+        memset(checkpoint.mapping, 0, checkpoint.size);
+
+        header.magic = checkpointMagic;
+        header.version = checkpointVersion;
+        header.scene = scene;
+        header.frame = noFrame;
+        header.tileCount = tileCount;
+    }
+
+    // The accumulation happens in the mapping from now on
+    color* pixels = reinterpret_cast<color*>(static_cast<uint8_t*>(checkpoint.mapping) + PixelsOffset(tileCount));
+
+    for (Tile& tile : tiles.tiles)
+    {
+        delete[] tile.pixels;
+        tile.pixels = pixels;
+
+        pixels += tile.size_x * tile.size_y;
+    }
+
+    checkpoint.lastFlush = std::chrono::steady_clock::now();
+
+    return true;
+}
+
+void CloseCheckpoint(Checkpoint& checkpoint, Tiles& tiles) noexcept
+{
+    if (checkpoint.mapping == nullptr) return;
+
+    for (Tile& tile : tiles.tiles) tile.pixels = new color[tile.size_x * tile.size_y]();
+
+    FlushMapping(checkpoint, true);
+    UnmapFile(checkpoint);
+
+    checkpoint.mapping = nullptr;
+    checkpoint.header = nullptr;
+    checkpoint.tileSamples = nullptr;
+    checkpoint.size = 0;
+}
+
+void BeginCheckpointFrame(Checkpoint& checkpoint, const uint32_t frame) noexcept
+{
+    CheckpointHeader& header = *checkpoint.header;
+
+    if (header.frame == frame) return;
+
+    // The tile buffers get overwritten by the first sample, only the counts need a reset
+    memset(checkpoint.tileSamples, 0, header.tileCount * sizeof(uint32_t));
+    header.frame = frame;
+
+    UpdateCheckpoint(checkpoint, true);
+}
+
+void UpdateCheckpoint(Checkpoint& checkpoint, const bool force) noexcept
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    if (!force && std::chrono::duration<float>(now - checkpoint.lastFlush).count() < checkpoint.interval) return;
+
+    FlushMapping(checkpoint, false);
+
+    checkpoint.lastFlush = now;
+}
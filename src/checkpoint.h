@@ -0,0 +1,54 @@
+#pragma once
+
+#include "batch.h"
+
+#include <chrono>
+
+// Checkpoint of a progressive batch render. The accumulation buffers of the tiles live directly in a memory
+// mapped file, so a checkpoint is only an asynchronous flush of the mapping and a crash or a preemption loses
+// at most the samples rendered since the last one. The file also records the scene, the frame being rendered
+// and the sample count of every tile, a resumed render continues each tile exactly where it stopped
+
+struct CheckpointHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    BatchScene scene;
+
+    uint32_t frame; // Frame being accumulated, the ones before it are done
+    uint32_t tileCount;
+};
+
+struct Checkpoint
+{
+    void* mapping = nullptr;
+    size_t size = 0;
+
+#ifdef _MSC_VER
+    void* file = nullptr;
+    void* fileMapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+    CheckpointHeader* header = nullptr;
+    uint32_t* tileSamples = nullptr; // Samples accumulated by each tile for the current frame
+
+    float interval = 30.0f; // Seconds between two flushes
+    std::chrono::steady_clock::time_point lastFlush;
+};
+
+// Maps the checkpoint file and moves the accumulation buffers of the progressive tiles into it. With resume an
+// existing checkpoint of the same scene is continued and resumed is set, otherwise the file starts over.
+// Returns false if the file could not be mapped
+bool OpenCheckpoint(Checkpoint& checkpoint, const char* path, const BatchScene& scene, Tiles& tiles, const bool resume, bool& resumed) noexcept;
+
+// Flushes and unmaps the file, the tiles get their own accumulation buffers back
+void CloseCheckpoint(Checkpoint& checkpoint, Tiles& tiles) noexcept;
+
+// Starts accumulating the given frame, unless the checkpoint already holds it
+void BeginCheckpointFrame(Checkpoint& checkpoint, const uint32_t frame) noexcept;
+
+// Schedules a flush of the mapping once the interval elapsed, or right away when forced
+void UpdateCheckpoint(Checkpoint& checkpoint, const bool force) noexcept;
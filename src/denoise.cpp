@@ -0,0 +1,312 @@
+#include "denoise.h"
+
+// B3 spline
+static constexpr float kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+static constexpr float log2e = 1.44269504088896341f;
+
+FORCEINLINE float Luminance(const float r, const float g, const float b) noexcept
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+void ResizeDenoiser(Denoiser& denoiser, const uint16_t xres, const uint16_t yres) noexcept
+{
+    if (denoiser.xres == xres && denoiser.yres == yres && denoiser.depth != nullptr) return;
+
+    ReleaseDenoiser(denoiser);
+
+    denoiser.xres = xres;
+    denoiser.yres = yres;
+
+    const size_t size = static_cast<size_t>(xres) * yres;
+
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        denoiser.color[0][c] = new float[size];
+        denoiser.color[1][c] = new float[size];
+        denoiser.normal[c] = new float[size];
+    }
+
+    denoiser.depth = new float[size];
+}
+
+void ReleaseDenoiser(Denoiser& denoiser) noexcept
+{
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        delete[] denoiser.color[0][c];
+        delete[] denoiser.color[1][c];
+        delete[] denoiser.normal[c];
+
+        denoiser.color[0][c] = nullptr;
+        denoiser.color[1][c] = nullptr;
+        denoiser.normal[c] = nullptr;
+    }
+
+    delete[] denoiser.depth;
+    denoiser.depth = nullptr;
+
+    denoiser.xres = 0;
+    denoiser.yres = 0;
+}
+
+// Constants of one iteration
+struct DenoisePass
+{
+    const float* source[3];
+    float* target[3];
+
+    int step;
+    float colorFalloff;  // log2(e) / sigma^2
+    float normalPower;
+    float depthFalloff;  // log2(e) / sigma
+};
+
+static void FilterPixel(const Denoiser& denoiser, const DenoisePass& pass, const int x, const int y) noexcept
+{
+    const int xres = denoiser.xres;
+    const int yres = denoiser.yres;
+    const int index = x + y * xres;
+
+    const float r = pass.source[0][index];
+    const float g = pass.source[1][index];
+    const float b = pass.source[2][index];
+
+    const float nx = denoiser.normal[0][index];
+    const float ny = denoiser.normal[1][index];
+    const float nz = denoiser.normal[2][index];
+    const float d = denoiser.depth[index];
+
+    const float lum = 1.0f + Luminance(r, g, b);
+    const float colorFalloff = pass.colorFalloff / (lum * lum);
+
+    const float center = kernel[2] * kernel[2];
+
+    float sumR = r * center;
+    float sumG = g * center;
+    float sumB = b * center;
+    float sumW = center;
+
+    for (int ky = 0; ky < 5; ky++)
+    {
+        const int sy = std::clamp(y + (ky - 2) * pass.step, 0, yres - 1);
+
+        for (int kx = 0; kx < 5; kx++)
+        {
+            if (kx == 2 && ky == 2) continue;
+
+            const int sx = std::clamp(x + (kx - 2) * pass.step, 0, xres - 1);
+            const int tap = sx + sy * xres;
+
+            const float tr = pass.source[0][tap];
+            const float tg = pass.source[1][tap];
+            const float tb = pass.source[2][tap];
+            const float td = denoiser.depth[tap];
+
+            float geometry;
+
+            if (d < 0.0f || td < 0.0f)
+            {
+                geometry = d < 0.0f && td < 0.0f ? 1.0f : 0.0f;
+            }
+            else
+            {
+                const float cosine = maths::max(1e-6f, nx * denoiser.normal[0][tap] + ny * denoiser.normal[1][tap] + nz * denoiser.normal[2][tap]);
+                const float distance = static_cast<float>(pass.step * (std::abs(kx - 2) + std::abs(ky - 2)));
+
+                geometry = std::pow(cosine, pass.normalPower) * std::exp2(-std::abs(d - td) * pass.depthFalloff / (d * distance));
+            }
+
+            const float dr = tr - r;
+            const float dg = tg - g;
+            const float db = tb - b;
+
+            const float weight = kernel[kx] * kernel[ky] * geometry * std::exp2(-(dr * dr + dg * dg + db * db) * colorFalloff);
+
+            sumR += tr * weight;
+            sumG += tg * weight;
+            sumB += tb * weight;
+            sumW += weight;
+        }
+    }
+
+    pass.target[0][index] = sumR / sumW;
+    pass.target[1][index] = sumG / sumW;
+    pass.target[2][index] = sumB / sumW;
+}
+
+// Same as FilterPixel for the 8 pixels starting at x, all the taps need to fall inside the row
+static void FilterPixels8(const Denoiser& denoiser, const DenoisePass& pass, const int x, const int y) noexcept
+{
+    const int xres = denoiser.xres;
+    const int yres = denoiser.yres;
+    const int index = x + y * xres;
+
+    const vfloat8 zero = _mm256_setzero_ps();
+    const vfloat8 one = set8(1.0f);
+
+    const vfloat8 r = loadu8(pass.source[0] + index);
+    const vfloat8 g = loadu8(pass.source[1] + index);
+    const vfloat8 b = loadu8(pass.source[2] + index);
+
+    const vfloat8 nx = loadu8(denoiser.normal[0] + index);
+    const vfloat8 ny = loadu8(denoiser.normal[1] + index);
+    const vfloat8 nz = loadu8(denoiser.normal[2] + index);
+    const vfloat8 d = loadu8(denoiser.depth + index);
+
+    const vfloat8 sky = _mm256_cmp_ps(d, zero, _CMP_LT_OQ);
+
+    const vfloat8 lum = add8(one, fmadd8(set8(0.2126f), r, fmadd8(set8(0.7152f), g, mul8(set8(0.0722f), b))));
+    const vfloat8 colorFalloff = div8(set8(pass.colorFalloff), mul8(lum, lum));
+
+    // Folded with the 1 / distance of the depth weight
+    const vfloat8 depthFalloff = div8(set8(pass.depthFalloff / pass.step), max8(d, set8(1e-6f)));
+
+    const vfloat8 center = set8(kernel[2] * kernel[2]);
+
+    vfloat8 sumR = mul8(r, center);
+    vfloat8 sumG = mul8(g, center);
+    vfloat8 sumB = mul8(b, center);
+    vfloat8 sumW = center;
+
+    for (int ky = 0; ky < 5; ky++)
+    {
+        const int sy = std::clamp(y + (ky - 2) * pass.step, 0, yres - 1);
+
+        for (int kx = 0; kx < 5; kx++)
+        {
+            if (kx == 2 && ky == 2) continue;
+
+            const int tap = x + (kx - 2) * pass.step + sy * xres;
+
+            const vfloat8 tr = loadu8(pass.source[0] + tap);
+            const vfloat8 tg = loadu8(pass.source[1] + tap);
+            const vfloat8 tb = loadu8(pass.source[2] + tap);
+            const vfloat8 td = loadu8(denoiser.depth + tap);
+
+            const vfloat8 tapSky = _mm256_cmp_ps(td, zero, _CMP_LT_OQ);
+
+            vfloat8 cosine = mul8(nx, loadu8(denoiser.normal[0] + tap));
+            cosine = fmadd8(ny, loadu8(denoiser.normal[1] + tap), cosine);
+            cosine = fmadd8(nz, loadu8(denoiser.normal[2] + tap), cosine);
+            cosine = max8(cosine, set8(1e-6f));
+
+            const vfloat8 depthDelta = _mm256_andnot_ps(set8(-0.0f), sub8(d, td));
+            const float inverseDistance = 1.0f / static_cast<float>(std::abs(kx - 2) + std::abs(ky - 2));
+
+            // normal^power * 2^(-depth term), in a single exp2
+            vfloat8 exponent = mul8(set8(pass.normalPower), log2_8(cosine));
+            exponent = fmadd8(mul8(depthDelta, depthFalloff), set8(-inverseDistance), exponent);
+
+            // Between two sky pixels only the color counts
+            const vfloat8 geometry = select8(_mm256_or_ps(sky, tapSky), zero, exponent);
+
+            const vfloat8 dr = sub8(tr, r);
+            const vfloat8 dg = sub8(tg, g);
+            const vfloat8 db = sub8(tb, b);
+
+            const vfloat8 colorDistance = fmadd8(dr, dr, fmadd8(dg, dg, mul8(db, db)));
+
+            vfloat8 weight = exp2_8(fmadd8(colorDistance, sub8(zero, colorFalloff), geometry));
+            weight = mul8(weight, set8(kernel[kx] * kernel[ky]));
+
+            // Only one side being sky cuts the tap
+            weight = _mm256_andnot_ps(_mm256_xor_ps(sky, tapSky), weight);
+
+            sumR = fmadd8(tr, weight, sumR);
+            sumG = fmadd8(tg, weight, sumG);
+            sumB = fmadd8(tb, weight, sumB);
+            sumW = add8(sumW, weight);
+        }
+    }
+
+    const vfloat8 normalization = div8(one, sumW);
+
+    storeu8(pass.target[0] + index, mul8(sumR, normalization));
+    storeu8(pass.target[1] + index, mul8(sumG, normalization));
+    storeu8(pass.target[2] + index, mul8(sumB, normalization));
+}
+
+void Denoise(Denoiser& denoiser, AOVs& aovs) noexcept
+{
+    ResizeDenoiser(denoiser, aovs.xres, aovs.yres);
+
+    const int xres = denoiser.xres;
+    const int yres = denoiser.yres;
+
+    const DenoiseSettings& settings = denoiser.settings;
+
+    // Planar copies of the beauty and the guides
+    tbb::parallel_for(tbb::blocked_range<int>(0, yres), [&](const tbb::blocked_range<int>& r)
+        {
+            for (int y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (int x = 0; x < xres; x++)
+                {
+                    const int index = x + y * xres;
+
+                    denoiser.color[0][0][index] = aovs.beauty[index].R;
+                    denoiser.color[0][1][index] = aovs.beauty[index].G;
+                    denoiser.color[0][2][index] = aovs.beauty[index].B;
+
+                    denoiser.normal[0][index] = aovs.normal[index].x;
+                    denoiser.normal[1][index] = aovs.normal[index].y;
+                    denoiser.normal[2][index] = aovs.normal[index].z;
+
+                    denoiser.depth[index] = aovs.depth[index] == maths::constants::inf ? -1.0f : aovs.depth[index];
+                }
+            }
+        });
+
+    uint32_t current = 0;
+
+    for (uint32_t i = 0; i < settings.iterations; i++)
+    {
+        const float sigma = settings.colorSigma / static_cast<float>(1 << i);
+
+        DenoisePass pass;
+
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            pass.source[c] = denoiser.color[current][c];
+            pass.target[c] = denoiser.color[current ^ 1][c];
+        }
+
+        pass.step = 1 << i;
+        pass.colorFalloff = log2e / (sigma * sigma);
+        pass.normalPower = settings.normalPower;
+        pass.depthFalloff = log2e / settings.depthSigma;
+
+        // The taps of the 8 wide blocks must stay inside the row, the borders are filtered one pixel at a time
+        const int border = 2 * pass.step;
+        const int vectorEnd = xres - border - 8;
+
+        tbb::parallel_for(tbb::blocked_range<int>(0, yres), [&](const tbb::blocked_range<int>& r)
+            {
+                for (int y = r.begin(), y_end = r.end(); y < y_end; y++)
+                {
+                    int x = 0;
+
+                    for (; x < border && x < xres; x++) FilterPixel(denoiser, pass, x, y);
+                    for (; x <= vectorEnd; x += 8) FilterPixels8(denoiser, pass, x, y);
+                    for (; x < xres; x++) FilterPixel(denoiser, pass, x, y);
+                }
+            });
+
+        current ^= 1;
+    }
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, yres), [&](const tbb::blocked_range<int>& r)
+        {
+            for (int y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (int x = 0; x < xres; x++)
+                {
+                    const int index = x + y * xres;
+
+                    aovs.beauty[index] = { denoiser.color[current][0][index], denoiser.color[current][1][index], denoiser.color[current][2][index] };
+                }
+            }
+        });
+}
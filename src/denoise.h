@@ -0,0 +1,39 @@
+#pragma once
+
+#include "render.h"
+#include "simd.h"
+
+// Edge-avoiding à-trous wavelet denoiser, run on the beauty aov after the render. Each iteration is a 5x5 B3
+// spline kernel whose taps get twice as far apart, weighted by the color, the normal and the depth of the
+// taps so the filter does not blur across wave silhouettes or the horizon. Sky pixels, the ones with an
+// infinite depth, only filter with other sky pixels. The planes are filtered 8 pixels at a time with avx2
+
+struct DenoiseSettings
+{
+    bool enabled = false;
+
+    uint8_t iterations = 4;    // Kernel footprint of 4 * 2^iterations pixels
+    float colorSigma = 0.5f;   // Color difference falloff, relative to the luminance and halved each iteration
+    float normalPower = 32.0f; // Normal falloff
+    float depthSigma = 0.02f;  // Relative depth difference falloff, per pixel of distance between the taps
+};
+
+struct Denoiser
+{
+    DenoiseSettings settings;
+
+    // Planar copies of the aovs, the color ones are ping-ponged between the iterations
+    float* color[2][3] = { { nullptr, nullptr, nullptr }, { nullptr, nullptr, nullptr } };
+    float* normal[3] = { nullptr, nullptr, nullptr };
+    float* depth = nullptr; // Negative on the sky
+
+    uint16_t xres = 0;
+    uint16_t yres = 0;
+};
+
+void ResizeDenoiser(Denoiser& denoiser, const uint16_t xres, const uint16_t yres) noexcept;
+
+void ReleaseDenoiser(Denoiser& denoiser) noexcept;
+
+// Filters the beauty plane of the aovs in place, they need their normal and depth planes
+void Denoise(Denoiser& denoiser, AOVs& aovs) noexcept;
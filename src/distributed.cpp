@@ -0,0 +1,381 @@
+#include "distributed.h"
+
+#ifndef _MSC_VER
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <map>
+#include <vector>
+
+enum MessageType : uint32_t
+{
+    Message_Scene = 0,  // BatchScene
+    Message_Job = 1,    // BandJob
+    Message_Result = 2, // BandJob, then the beauty rows and with layers the normal and depth ones
+    Message_Done = 3
+};
+
+struct MessageHeader
+{
+    uint32_t type;
+    uint32_t size; // Of the payload
+};
+
+struct BandJob
+{
+    uint32_t frame;
+    uint16_t yStart;
+    uint16_t yEnd;
+    uint32_t layers; // The normal and depth rows are only rendered and sent for the layered format
+};
+
+struct WorkerConnection
+{
+    int socket;
+    bool busy;
+    BandJob job;
+};
+
+struct FrameAssembly
+{
+    ImageBuffer* image;
+    uint32_t remainingBands;
+};
+
+FORCEINLINE size_t GetBandSize(const uint32_t xres, const BandJob& job) noexcept
+{
+    return static_cast<size_t>(xres) * (job.yEnd - job.yStart) * (job.layers ? 7 : 3) * sizeof(float);
+}
+
+static bool SendAll(const int socket, const void* data, size_t size) noexcept
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    while (size > 0)
+    {
+        const ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+
+        bytes += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+static bool ReceiveAll(const int socket, void* data, size_t size) noexcept
+{
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+
+    while (size > 0)
+    {
+        const ssize_t received = recv(socket, bytes, size, 0);
+
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+
+        bytes += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+static bool SendMessage(const int socket, const MessageType type, const void* payload, const uint32_t size) noexcept
+{
+    const MessageHeader header = { type, size };
+
+    return SendAll(socket, &header, sizeof(header)) && (size == 0 || SendAll(socket, payload, size));
+}
+
+static bool MakeAddress(const char* path, sockaddr_un& address) noexcept
+{
+    if (strlen(path) >= sizeof(address.sun_path)) return false;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    return true;
+}
+
+// Receives a band straight into the rows of the frame it belongs to
+static bool ReceiveResult(WorkerConnection& worker, const MessageHeader& header, const BatchScene& scene, std::map<uint32_t, FrameAssembly>& assemblies) noexcept
+{
+    BandJob job;
+
+    if (header.type != Message_Result || !ReceiveAll(worker.socket, &job, sizeof(job))) return false;
+
+    if (!worker.busy || job.frame != worker.job.frame || job.yStart != worker.job.yStart || job.yEnd != worker.job.yEnd ||
+        job.layers != worker.job.layers) return false;
+    if (header.size != sizeof(BandJob) + GetBandSize(scene.xres, job)) return false;
+
+    ImageBuffer* image = assemblies[job.frame].image;
+
+    const size_t pixels = static_cast<size_t>(scene.xres) * (job.yEnd - job.yStart);
+    const size_t offset = static_cast<size_t>(scene.xres) * job.yStart;
+
+    if (!ReceiveAll(worker.socket, image->beauty + offset * 3, pixels * 3 * sizeof(float))) return false;
+
+    return !job.layers ||
+           (ReceiveAll(worker.socket, image->normal + offset * 3, pixels * 3 * sizeof(float)) &&
+            ReceiveAll(worker.socket, image->depth + offset, pixels * sizeof(float)));
+}
+
+bool RunCoordinator(const CoordinatorSettings& settings, const BatchScene& scene, ImageWriter& writer, FILE* log) noexcept
+{
+    sockaddr_un address;
+
+    if (!MakeAddress(settings.socketPath, address)) return false;
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0) return false;
+
+    unlink(settings.socketPath);
+
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+        close(listener);
+        return false;
+    }
+
+    const uint16_t bandRows = settings.bandRows > 0 ? std::min(settings.bandRows, scene.yres) : scene.yres;
+    const uint32_t bandCount = (scene.yres + bandRows - 1) / bandRows;
+
+    // A frame keeps its image buffer until all its bands are in, more frames than buffers would deadlock
+    const size_t maxFramesInFlight = writer.buffers.size();
+
+    std::vector<WorkerConnection> workers;
+    std::deque<BandJob> pending;
+    std::map<uint32_t, FrameAssembly> assemblies;
+
+    uint32_t nextFrame = settings.firstFrame;
+    uint32_t completedFrames = 0;
+
+    const auto dropWorker = [&](const size_t index)
+    {
+        WorkerConnection& worker = workers[index];
+
+        // Its band goes first so the frame it belongs to completes as soon as possible
+        if (worker.busy) pending.push_front(worker.job);
+
+        close(worker.socket);
+        workers.erase(workers.begin() + index);
+
+        fprintf(log, "Worker lost, %zu left\n", workers.size());
+    };
+
+    while (completedFrames < settings.frameCount)
+    {
+        while (pending.empty() && nextFrame < settings.firstFrame + settings.frameCount && assemblies.size() < maxFramesInFlight)
+        {
+            assemblies[nextFrame] = { AcquireImageBuffer(writer), bandCount };
+
+            for (uint32_t band = 0; band < bandCount; band++)
+            {
+                const uint16_t yStart = band * bandRows;
+                const uint16_t yEnd = std::min<uint32_t>(yStart + bandRows, scene.yres);
+
+                pending.push_back({ nextFrame, yStart, yEnd, settings.format == ImageFileFormat::Layers });
+            }
+
+            nextFrame++;
+        }
+
+        for (size_t i = 0; i < workers.size() && !pending.empty(); i++)
+        {
+            if (workers[i].busy) continue;
+
+            workers[i].job = pending.front();
+            pending.pop_front();
+
+            if (!SendMessage(workers[i].socket, Message_Job, &workers[i].job, sizeof(BandJob)))
+            {
+                pending.push_front(workers[i].job);
+                dropWorker(i--);
+                continue;
+            }
+
+            workers[i].busy = true;
+        }
+
+        std::vector<pollfd> fds(workers.size() + 1);
+
+        fds[0] = { listener, POLLIN, 0 };
+
+        for (size_t i = 0; i < workers.size(); i++) fds[i + 1] = { workers[i].socket, POLLIN, 0 };
+
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) break;
+
+        // Backwards so dropping a worker does not shift the ones still to be processed
+        for (size_t i = workers.size(); i > 0; i--)
+        {
+            if (fds[i].revents == 0) continue;
+
+            WorkerConnection& worker = workers[i - 1];
+
+            MessageHeader header;
+
+            if (!ReceiveAll(worker.socket, &header, sizeof(header)) || !ReceiveResult(worker, header, scene, assemblies))
+            {
+                dropWorker(i - 1);
+                continue;
+            }
+
+            worker.busy = false;
+
+            FrameAssembly& assembly = assemblies[worker.job.frame];
+
+            if (--assembly.remainingBands > 0) continue;
+
+            char path[1024];
+            snprintf(path, sizeof(path), settings.output, worker.job.frame);
+
+            SubmitImage(writer, assembly.image, path, settings.format);
+            assemblies.erase(worker.job.frame);
+
+            completedFrames++;
+
+            fprintf(log, "Frame %u : %s (%u/%u)\n", worker.job.frame, path, completedFrames, settings.frameCount);
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            const int connection = accept(listener, nullptr, nullptr);
+
+            if (connection >= 0)
+            {
+                if (SendMessage(connection, Message_Scene, &scene, sizeof(BatchScene)))
+                {
+                    workers.push_back({ connection, false, {} });
+
+                    fprintf(log, "Worker connected, %zu total\n", workers.size());
+                }
+                else
+                {
+                    close(connection);
+                }
+            }
+        }
+    }
+
+    for (WorkerConnection& worker : workers)
+    {
+        SendMessage(worker.socket, Message_Done, nullptr, 0);
+        close(worker.socket);
+    }
+
+    close(listener);
+    unlink(settings.socketPath);
+
+    return completedFrames == settings.frameCount;
+}
+
+bool RunWorker(const char* socketPath, FILE* log) noexcept
+{
+    sockaddr_un address;
+
+    if (!MakeAddress(socketPath, address)) return false;
+
+    const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (connection < 0) return false;
+
+    // Workers may be started before the coordinator
+    bool connected = false;
+
+    for (uint32_t attempt = 0; attempt < 100 && !connected; attempt++)
+    {
+        connected = connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+
+        if (!connected) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    MessageHeader header;
+    BatchScene scene;
+
+    if (!connected ||
+        !ReceiveAll(connection, &header, sizeof(header)) ||
+        header.type != Message_Scene || header.size != sizeof(BatchScene) ||
+        !ReceiveAll(connection, &scene, sizeof(BatchScene)))
+    {
+        close(connection);
+        return false;
+    }
+
+    BatchRenderer renderer;
+    InitBatchRenderer(renderer, scene, false);
+
+    const size_t pixels = static_cast<size_t>(scene.xres) * scene.yres;
+
+    // Result message layout, the job followed by the rows
+    uint8_t* result = new uint8_t[sizeof(BandJob) + pixels * 7 * sizeof(float)];
+
+    bool success = false;
+
+    while (ReceiveAll(connection, &header, sizeof(header)))
+    {
+        if (header.type == Message_Done)
+        {
+            success = true;
+            break;
+        }
+
+        BandJob job;
+
+        if (header.type != Message_Job || header.size != sizeof(BandJob) || !ReceiveAll(connection, &job, sizeof(job))) break;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        const size_t bandPixels = static_cast<size_t>(scene.xres) * (job.yEnd - job.yStart);
+
+        float* beauty = reinterpret_cast<float*>(result + sizeof(BandJob));
+        float* normal = beauty + bandPixels * 3;
+        float* depth = normal + bandPixels * 3;
+
+        memcpy(result, &job, sizeof(BandJob));
+
+        SetBatchFrame(renderer, scene, job.frame);
+        RenderBatchRows(renderer, scene, job.yStart, job.yEnd, beauty, job.layers ? normal : nullptr, job.layers ? depth : nullptr);
+
+        if (!SendMessage(connection, Message_Result, result, sizeof(BandJob) + GetBandSize(scene.xres, job))) break;
+
+        const auto end = std::chrono::steady_clock::now();
+
+        fprintf(log, "Frame %u rows %u-%u (%0.3f ms)\n", job.frame, job.yStart, job.yEnd, std::chrono::duration<float, std::milli>(end - start).count());
+    }
+
+    delete[] result;
+
+    ReleaseBatchRenderer(renderer);
+    close(connection);
+
+    return success;
+}
+
+#else
+
+bool RunCoordinator(const CoordinatorSettings& settings, const BatchScene& scene, ImageWriter& writer, FILE* log) noexcept
+{
+    fprintf(log, "Distributed rendering is not supported on this platform\n");
+    return false;
+}
+
+bool RunWorker(const char* socketPath, FILE* log) noexcept
+{
+    fprintf(log, "Distributed rendering is not supported on this platform\n");
+    return false;
+}
+
+#endif
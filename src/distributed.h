@@ -0,0 +1,30 @@
+#pragma once
+
+#include "batch.h"
+#include "imagewriter.h"
+
+#include <stdio.h>
+
+// Distributed batch rendering over a local Unix socket. The coordinator splits the frames into bands of rows and
+// hands them out to the workers that connect, then assembles their results into full frames for the image writer.
+// The workers get the scene from the coordinator and the blue noise only depends on the pixel and the sample, so
+// any worker renders a band exactly the same way. The band of a worker that goes away is handed out again.
+// POSIX only, the functions fail on other platforms
+
+struct CoordinatorSettings
+{
+    const char* socketPath = nullptr;
+
+    uint32_t firstFrame = 0;
+    uint32_t frameCount = 1;
+    uint16_t bandRows = 0; // 0 hands out whole frames
+
+    const char* output = nullptr; // printf pattern of the files, given the frame number
+    ImageFileFormat format = ImageFileFormat::PPM;
+};
+
+// Returns once every frame has been handed to the writer, false if the socket could not be set up
+bool RunCoordinator(const CoordinatorSettings& settings, const BatchScene& scene, ImageWriter& writer, FILE* log) noexcept;
+
+// Renders the bands sent by the coordinator until it is done, false if the connection failed or got lost
+bool RunWorker(const char* socketPath, FILE* log) noexcept;
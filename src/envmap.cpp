@@ -0,0 +1,132 @@
+#include "envmap.h"
+
+#include "tbb/parallel_for.h"
+
+#include <algorithm>
+
+static bool SameSky(const Sky& a, const Sky& b) noexcept
+{
+    return a.sun.direction.x == b.sun.direction.x && a.sun.direction.y == b.sun.direction.y && a.sun.direction.z == b.sun.direction.z &&
+           a.sun.color.x == b.sun.color.x && a.sun.color.y == b.sun.color.y && a.sun.color.z == b.sun.color.z &&
+           a.color1.x == b.color1.x && a.color1.y == b.color1.y && a.color1.z == b.color1.z &&
+           a.color2.x == b.color2.x && a.color2.y == b.color2.y && a.color2.z == b.color2.z;
+}
+
+// Luminance times the solid angle of the texels of the sampled level
+static void BuildEnvMapSampler(EnvMap& envMap) noexcept
+{
+    uint8_t level = 0;
+    while (level + 1 < envMap.levelCount && envMap.resolutions[level] > envMapSamplingResolution) level++;
+
+    const uint32_t res = envMap.resolutions[level];
+    const vec3* texels = envMap.levels[level];
+
+    float* weights = new float[res * res];
+
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, res), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (uint32_t x = 0; x < res; x++)
+                {
+                    const vec3& texel = texels[x + y * res];
+                    const vec3 direction = OctahedralDecode(vec2((x + 0.5f) / res, (y + 0.5f) / res));
+
+                    const float luminance = 0.2126f * texel.x + 0.7152f * texel.y + 0.0722f * texel.z;
+
+                    weights[x + y * res] = maths::max(0.0f, luminance) * OctahedralJacobian(direction);
+                }
+            }
+        });
+
+    BuildAliasTable(envMap.sampler, weights, res * res);
+
+    envMap.samplerLevel = level;
+
+    delete[] weights;
+}
+
+void BakeEnvMap(EnvMap& envMap, const Sky& sky) noexcept
+{
+    if (envMap.levelCount == 0 || envMap.resolutions[0] != envMap.resolution)
+    {
+        ReleaseEnvMap(envMap);
+
+        uint32_t res = envMap.resolution;
+
+        while (res > 0 && envMap.levelCount < envMapMaxLevels)
+        {
+            envMap.resolutions[envMap.levelCount] = res;
+            envMap.levels[envMap.levelCount] = new vec3[res * res];
+            envMap.levelCount++;
+
+            res /= 2;
+        }
+    }
+
+    envMap.sky = sky;
+    envMap.sky.envMap = nullptr;
+
+    const uint32_t res = envMap.resolutions[0];
+    vec3* texels = envMap.levels[0];
+
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, res), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (uint32_t x = 0; x < res; x++)
+                {
+                    const vec3 direction = OctahedralDecode(vec2((x + 0.5f) / res, (y + 0.5f) / res));
+
+                    texels[x + y * res] = SampleSky(direction, envMap.sky);
+                }
+            }
+        });
+
+    // Box filtered mips, the octahedral layout is preserved by a 2x2 reduction
+    for (uint8_t level = 1; level < envMap.levelCount; level++)
+    {
+        const uint32_t levelRes = envMap.resolutions[level];
+        const uint32_t parentRes = envMap.resolutions[level - 1];
+        const vec3* parent = envMap.levels[level - 1];
+        vec3* current = envMap.levels[level];
+
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, levelRes), [&](const tbb::blocked_range<uint32_t>& r)
+            {
+                for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+                {
+                    for (uint32_t x = 0; x < levelRes; x++)
+                    {
+                        const uint32_t index = x * 2 + y * 2 * parentRes;
+
+                        current[x + y * levelRes] = (parent[index] + parent[index + 1] + parent[index + parentRes] + parent[index + parentRes + 1]) * 0.25f;
+                    }
+                }
+            });
+    }
+
+    BuildEnvMapSampler(envMap);
+}
+
+bool UpdateEnvMap(EnvMap& envMap, const Sky& sky) noexcept
+{
+    if (envMap.levelCount > 0 && envMap.resolutions[0] == envMap.resolution && SameSky(envMap.sky, sky)) return false;
+
+    BakeEnvMap(envMap, sky);
+
+    return true;
+}
+
+void ReleaseEnvMap(EnvMap& envMap) noexcept
+{
+    for (uint8_t level = 0; level < envMap.levelCount; level++)
+    {
+        delete[] envMap.levels[level];
+        envMap.levels[level] = nullptr;
+        envMap.resolutions[level] = 0;
+    }
+
+    envMap.levelCount = 0;
+
+    ReleaseAliasTable(envMap.sampler);
+}
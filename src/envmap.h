@@ -0,0 +1,168 @@
+#pragma once
+
+#include "sky.h"
+#include "vec2.h"
+#include "aliastable.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+// Octahedral environment map baked from the analytic sky. The reflections sample it instead of evaluating
+// the sky, and the prefiltered mip chain gives glossy reflections at distance where the wave normals vary
+// a lot within a pixel. Any sky model can be baked here without slowing down the shading.
+//
+// The path tracer samples the sky through an alias table over the luminance of a coarse level, rebuilt with
+// every bake. Directions are drawn uniformly inside the picked texel, and the exact jacobian of the octahedral
+// mapping turns the texel density into a solid angle pdf
+
+static constexpr uint8_t envMapMaxLevels = 12;
+
+// The sampled level is the first one at or below this resolution. The sun has its own sampling, the table only
+// needs to follow the broad gradients
+static constexpr uint16_t envMapSamplingResolution = 128;
+
+struct EnvMap
+{
+    vec3* levels[envMapMaxLevels] = { nullptr };
+    uint16_t resolutions[envMapMaxLevels] = { 0 };
+    uint8_t levelCount = 0;
+
+    uint16_t resolution = 512;   // Of the first level, power of two
+    float glossyDistance = 50.0f; // Distance from the camera at which the reflections start to use the mips
+
+    Sky sky; // The sky the map has been baked from
+
+    AliasTable sampler; // Over the texels of the sampled level
+    uint8_t samplerLevel = 0;
+};
+
+// Bakes the sky and its mips
+void BakeEnvMap(EnvMap& envMap, const Sky& sky) noexcept;
+
+// Bakes the sky only if it changed since the last bake, returns true if it did
+bool UpdateEnvMap(EnvMap& envMap, const Sky& sky) noexcept;
+
+void ReleaseEnvMap(EnvMap& envMap) noexcept;
+
+FORCEINLINE vec2 OctahedralEncode(const vec3& direction) noexcept
+{
+    const vec3 n = direction / (maths::abs(direction.x) + maths::abs(direction.y) + maths::abs(direction.z));
+
+    vec2 uv(n.x, n.z);
+
+    // Fold the lower hemisphere over the corners
+    if (n.y < 0.0f)
+    {
+        uv = vec2((1.0f - maths::abs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                  (1.0f - maths::abs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    return uv * 0.5f + vec2(0.5f);
+}
+
+FORCEINLINE vec3 OctahedralDecode(const vec2& uv) noexcept
+{
+    float x = uv.x * 2.0f - 1.0f;
+    float z = uv.y * 2.0f - 1.0f;
+    const float y = 1.0f - maths::abs(x) - maths::abs(z);
+
+    if (y < 0.0f)
+    {
+        const float fx = (1.0f - maths::abs(z)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float fz = (1.0f - maths::abs(x)) * (z >= 0.0f ? 1.0f : -1.0f);
+
+        x = fx;
+        z = fz;
+    }
+
+    return normalize(vec3(x, y, z));
+}
+
+FORCEINLINE vec3 SampleEnvMapLevel(const EnvMap& envMap, const vec2& uv, const uint8_t level) noexcept
+{
+    const uint32_t res = envMap.resolutions[level];
+    const vec3* texels = envMap.levels[level];
+
+    // Texel centers are at half integer coordinates
+    const float px = maths::clamp(uv.x * res - 0.5f, 0.0f, res - 1.0f);
+    const float py = maths::clamp(uv.y * res - 0.5f, 0.0f, res - 1.0f);
+
+    const uint32_t x0 = static_cast<uint32_t>(px);
+    const uint32_t y0 = static_cast<uint32_t>(py);
+    const uint32_t x1 = std::min<uint32_t>(x0 + 1, res - 1);
+    const uint32_t y1 = std::min<uint32_t>(y0 + 1, res - 1);
+
+    const float fx = px - x0;
+    const float fy = py - y0;
+
+    const vec3 top = lerp(texels[x0 + y0 * res], texels[x1 + y0 * res], fx);
+    const vec3 bottom = lerp(texels[x0 + y1 * res], texels[x1 + y1 * res], fx);
+
+    return lerp(top, bottom, fy);
+}
+
+// Trilinear lookup, lod 0 is the full resolution level
+FORCEINLINE vec3 SampleEnvMap(const EnvMap& envMap, const vec3& direction, const float lod) noexcept
+{
+    const vec2 uv = OctahedralEncode(direction);
+
+    const float level = maths::clamp(lod, 0.0f, envMap.levelCount - 1.0f);
+    const uint8_t level0 = static_cast<uint8_t>(level);
+    const uint8_t level1 = std::min<uint8_t>(level0 + 1, envMap.levelCount - 1);
+
+    const vec3 sample0 = SampleEnvMapLevel(envMap, uv, level0);
+
+    if (level0 == level1) return sample0;
+
+    return lerp(sample0, SampleEnvMapLevel(envMap, uv, level1), level - level0);
+}
+
+// Sky seen by a reflection at the given distance from the camera, from the baked map when there is one
+FORCEINLINE vec3 SampleSkyReflection(const vec3& direction, const Sky& sky, const float distance) noexcept
+{
+    if (sky.envMap == nullptr) return SampleSky(direction, sky);
+
+    const float lod = maths::log2(maths::max(1.0f, distance / sky.envMap->glossyDistance));
+
+    return SampleEnvMap(*sky.envMap, direction, lod);
+}
+
+// Solid angle density of the octahedral mapping, dw = 4 * |d|_1^3 * du dv for a unit direction
+FORCEINLINE float OctahedralJacobian(const vec3& direction) noexcept
+{
+    const float l1 = maths::abs(direction.x) + maths::abs(direction.y) + maths::abs(direction.z);
+
+    return 4.0f * l1 * l1 * l1;
+}
+
+FORCEINLINE bool HasEnvMapSampler(const Sky& sky) noexcept
+{
+    return sky.envMap != nullptr && sky.envMap->sampler.count > 0;
+}
+
+// Draws a direction with a density proportional to the luminance of the sky
+FORCEINLINE vec3 SampleEnvMapDirection(const EnvMap& envMap, const float u, const float v, float& pdf) noexcept
+{
+    const uint32_t res = envMap.resolutions[envMap.samplerLevel];
+
+    float remaining;
+    const uint32_t index = SampleAliasTable(envMap.sampler, u, remaining);
+
+    const vec3 direction = OctahedralDecode(vec2((index % res + remaining) / res, (index / res + v) / res));
+
+    pdf = envMap.sampler.entries[index].probability * (res * res) / OctahedralJacobian(direction);
+
+    return direction;
+}
+
+// Density of SampleEnvMapDirection
+FORCEINLINE float EnvMapPdf(const EnvMap& envMap, const vec3& direction) noexcept
+{
+    const uint32_t res = envMap.resolutions[envMap.samplerLevel];
+    const vec2 uv = OctahedralEncode(direction);
+
+    const uint32_t x = std::min<uint32_t>(static_cast<uint32_t>(uv.x * res), res - 1);
+    const uint32_t y = std::min<uint32_t>(static_cast<uint32_t>(uv.y * res), res - 1);
+
+    return envMap.sampler.entries[x + y * res].probability * (res * res) / OctahedralJacobian(direction);
+}
@@ -0,0 +1,3 @@
+// Single implementation of the flythrough camera, shared by the interactive app and the headless renderer
+#define FLYTHROUGH_CAMERA_IMPLEMENTATION
+#include "flythrough_camera.h"
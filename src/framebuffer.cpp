@@ -0,0 +1,30 @@
+#include "framebuffer.h"
+#include "numa.h"
+
+void AllocateFrameBuffer(FrameBuffer& buffer, const uint16_t xres, const uint16_t yres, const OutputFormat format, NumaTopology* numa) noexcept
+{
+    ReleaseFrameBuffer(buffer);
+
+    buffer.xres = xres;
+    buffer.yres = yres;
+    buffer.format = format;
+
+    buffer.data = new uint8_t[GetFrameBufferSize(buffer)];
+
+    if (IsNumaEnabled(numa))
+    {
+        // Planar formats have one byte per channel and per plane
+        if (format == OutputFormat::YUV444) FirstTouchRows(*numa, buffer.data, xres, yres, 3);
+        else FirstTouchRows(*numa, buffer.data, xres * GetPixelSize(format), yres);
+    }
+    else
+    {
+        memset(buffer.data, 0, GetFrameBufferSize(buffer));
+    }
+}
+
+void ReleaseFrameBuffer(FrameBuffer& buffer) noexcept
+{
+    delete[] static_cast<uint8_t*>(buffer.data);
+    buffer.data = nullptr;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "vec3.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Output formats the resolve can write to. The display texture upload follows the format of the buffer
+// so we only move as many bytes per pixel as needed
+
+enum class OutputFormat : uint8_t
+{
+    RGBA8 = 0,
+    RGB16F = 1,
+    RGB32F = 2,
+
+    // Mostly for streaming to external encoders
+    RGB8 = 3,
+    RGB16 = 4,
+    YUV444 = 5 // 8 bits planar Y, Cb, Cr, limited range BT.601
+};
+
+struct FrameBuffer
+{
+    void* data = nullptr;
+
+    uint16_t xres = 0;
+    uint16_t yres = 0;
+
+    OutputFormat format = OutputFormat::RGBA8;
+};
+
+FORCEINLINE size_t GetPixelSize(const OutputFormat format) noexcept
+{
+    switch (format)
+    {
+    case OutputFormat::RGBA8: return 4 * sizeof(uint8_t);
+    case OutputFormat::RGB16F: return 3 * sizeof(uint16_t);
+    case OutputFormat::RGB32F: return 3 * sizeof(float);
+    case OutputFormat::RGB8: return 3 * sizeof(uint8_t);
+    case OutputFormat::RGB16: return 3 * sizeof(uint16_t);
+    case OutputFormat::YUV444: return 3 * sizeof(uint8_t);
+    }
+
+    return 0;
+}
+
+FORCEINLINE size_t GetFrameBufferSize(const FrameBuffer& buffer) noexcept
+{
+    return static_cast<size_t>(buffer.xres) * static_cast<size_t>(buffer.yres) * GetPixelSize(buffer.format);
+}
+
+struct NumaTopology;
+
+// The buffer is cleared, from the NUMA nodes owning its rows when given
+void AllocateFrameBuffer(FrameBuffer& buffer, const uint16_t xres, const uint16_t yres, const OutputFormat format, NumaTopology* numa = nullptr) noexcept;
+
+void ReleaseFrameBuffer(FrameBuffer& buffer) noexcept;
+
+// Writes an already gamma corrected color at the given pixel index, converting it to the buffer format
+
+FORCEINLINE void SetFrameBufferPixel(FrameBuffer& buffer, const size_t index, const vec3& color) noexcept
+{
+    switch (buffer.format)
+    {
+    case OutputFormat::RGBA8:
+        {
+            uint8_t* pixel = static_cast<uint8_t*>(buffer.data) + index * 4;
+            pixel[0] = static_cast<uint8_t>(maths::clamp(color.x) * 255.0f + 0.5f);
+            pixel[1] = static_cast<uint8_t>(maths::clamp(color.y) * 255.0f + 0.5f);
+            pixel[2] = static_cast<uint8_t>(maths::clamp(color.z) * 255.0f + 0.5f);
+            pixel[3] = 255;
+            break;
+        }
+    case OutputFormat::RGB16F:
+        {
+            const __m128i halfs = _mm_cvtps_ph(_mm_set_ps(0.0f, color.z, color.y, color.x), _MM_FROUND_TO_NEAREST_INT);
+            uint16_t tmp[8];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(tmp), halfs);
+            memcpy(static_cast<uint16_t*>(buffer.data) + index * 3, tmp, 3 * sizeof(uint16_t));
+            break;
+        }
+    case OutputFormat::RGB32F:
+        {
+            float* pixel = static_cast<float*>(buffer.data) + index * 3;
+            pixel[0] = color.x;
+            pixel[1] = color.y;
+            pixel[2] = color.z;
+            break;
+        }
+    case OutputFormat::RGB8:
+        {
+            uint8_t* pixel = static_cast<uint8_t*>(buffer.data) + index * 3;
+            pixel[0] = static_cast<uint8_t>(maths::clamp(color.x) * 255.0f + 0.5f);
+            pixel[1] = static_cast<uint8_t>(maths::clamp(color.y) * 255.0f + 0.5f);
+            pixel[2] = static_cast<uint8_t>(maths::clamp(color.z) * 255.0f + 0.5f);
+            break;
+        }
+    case OutputFormat::RGB16:
+        {
+            uint16_t* pixel = static_cast<uint16_t*>(buffer.data) + index * 3;
+            pixel[0] = static_cast<uint16_t>(maths::clamp(color.x) * 65535.0f + 0.5f);
+            pixel[1] = static_cast<uint16_t>(maths::clamp(color.y) * 65535.0f + 0.5f);
+            pixel[2] = static_cast<uint16_t>(maths::clamp(color.z) * 65535.0f + 0.5f);
+            break;
+        }
+    case OutputFormat::YUV444:
+        {
+            const float r = maths::clamp(color.x);
+            const float g = maths::clamp(color.y);
+            const float b = maths::clamp(color.z);
+
+            const float y = 0.299f * r + 0.587f * g + 0.114f * b;
+            const float cb = (b - y) / 1.772f;
+            const float cr = (r - y) / 1.402f;
+
+            const size_t planeSize = static_cast<size_t>(buffer.xres) * static_cast<size_t>(buffer.yres);
+
+            uint8_t* planes = static_cast<uint8_t*>(buffer.data);
+            planes[index] = static_cast<uint8_t>(16.0f + 219.0f * y + 0.5f);
+            planes[index + planeSize] = static_cast<uint8_t>(128.0f + 224.0f * cb + 0.5f);
+            planes[index + planeSize * 2] = static_cast<uint8_t>(128.0f + 224.0f * cr + 0.5f);
+            break;
+        }
+    }
+}
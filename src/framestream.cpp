@@ -0,0 +1,118 @@
+#include "framestream.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+static void StreamLoop(FrameStream& stream) noexcept
+{
+    while (true)
+    {
+        FrameBuffer* buffer = nullptr;
+        stream.pending.pop(buffer);
+
+        if (buffer == nullptr) break;
+
+        // Once the consumer is gone there is no point in writing the following frames
+        if (!stream.failed.load(std::memory_order_relaxed))
+        {
+            const size_t size = GetFrameBufferSize(*buffer);
+
+            bool success = !stream.y4m || fputs("FRAME\n", stream.file) >= 0;
+            success = success && fwrite(buffer->data, 1, size, stream.file) == size;
+            success = success && fflush(stream.file) == 0;
+
+            if (!success) stream.failed.store(true, std::memory_order_relaxed);
+        }
+
+        stream.freeBuffers.push(buffer);
+    }
+}
+
+bool OpenFrameStream(FrameStream& stream,
+                     const char* path,
+                     const OutputFormat format,
+                     const uint16_t xres,
+                     const uint16_t yres,
+                     const bool y4m,
+                     const uint32_t fpsNumerator,
+                     const uint32_t fpsDenominator) noexcept
+{
+    if (y4m != (format == OutputFormat::YUV444)) return false;
+    if (format == OutputFormat::RGBA8 || format == OutputFormat::RGB16F) return false;
+
+    if (strcmp(path, "-") == 0)
+    {
+#ifdef _MSC_VER
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        stream.file = stdout;
+    }
+    else
+    {
+        stream.file = fopen(path, "wb");
+    }
+
+    if (stream.file == nullptr) return false;
+
+    // Unbuffered, the frames go from our buffers to the file without an extra copy in the stdio buffer
+    setvbuf(stream.file, nullptr, _IONBF, 0);
+
+    stream.y4m = y4m;
+    stream.failed.store(false);
+
+    if (y4m && fprintf(stream.file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C444\n", xres, yres, fpsNumerator, fpsDenominator) < 0)
+    {
+        CloseFrameStream(stream);
+        return false;
+    }
+
+    for (FrameBuffer& buffer : stream.buffers)
+    {
+        AllocateFrameBuffer(buffer, xres, yres, format);
+        stream.freeBuffers.push(&buffer);
+    }
+
+    stream.thread = std::thread(StreamLoop, std::ref(stream));
+
+    return true;
+}
+
+bool CloseFrameStream(FrameStream& stream) noexcept
+{
+    if (stream.thread.joinable())
+    {
+        stream.pending.push(nullptr);
+        stream.thread.join();
+    }
+
+    stream.freeBuffers.clear();
+
+    for (FrameBuffer& buffer : stream.buffers) ReleaseFrameBuffer(buffer);
+
+    bool success = !stream.failed.load();
+
+    if (stream.file != nullptr)
+    {
+        success = (stream.file == stdout ? fflush(stream.file) : fclose(stream.file)) == 0 && success;
+        stream.file = nullptr;
+    }
+
+    return success;
+}
+
+FrameBuffer* AcquireStreamBuffer(FrameStream& stream) noexcept
+{
+    FrameBuffer* buffer = nullptr;
+    stream.freeBuffers.pop(buffer);
+
+    return buffer;
+}
+
+void SubmitStreamFrame(FrameStream& stream, FrameBuffer* buffer) noexcept
+{
+    stream.pending.push(buffer);
+}
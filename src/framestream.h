@@ -0,0 +1,49 @@
+#pragma once
+
+#include "framebuffer.h"
+
+#include "tbb/concurrent_queue.h"
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+// Raw frame streaming to stdout or a named pipe, for external encoders. The resolve writes the final pixel
+// format straight into the stream buffers, which are then written as is, the only copy being the one the
+// kernel does. Two buffers let the next frame render while the previous one is written, and the blocking
+// writes slow the renderer down to the pace of the consumer
+
+struct FrameStream
+{
+    FILE* file = nullptr;
+
+    bool y4m = false; // Y4M header and frame markers, needs the YUV444 format
+
+    FrameBuffer buffers[2];
+
+    tbb::concurrent_bounded_queue<FrameBuffer*> pending;
+    tbb::concurrent_bounded_queue<FrameBuffer*> freeBuffers;
+
+    std::thread thread;
+
+    std::atomic<bool> failed{ false };
+};
+
+// Opens the stream, "-" is stdout. Raw streams take RGB8, RGB16 or RGB32F, Y4M streams need YUV444.
+// Opening a named pipe blocks until the consumer opens it too
+bool OpenFrameStream(FrameStream& stream,
+                     const char* path,
+                     const OutputFormat format,
+                     const uint16_t xres,
+                     const uint16_t yres,
+                     const bool y4m,
+                     const uint32_t fpsNumerator,
+                     const uint32_t fpsDenominator) noexcept;
+
+// Writes the pending frames and closes the stream, returns false if any write failed
+bool CloseFrameStream(FrameStream& stream) noexcept;
+
+// Blocks while both buffers are in flight
+FrameBuffer* AcquireStreamBuffer(FrameStream& stream) noexcept;
+
+void SubmitStreamFrame(FrameStream& stream, FrameBuffer* buffer) noexcept;
@@ -2,6 +2,7 @@
 
 #include "GL/glew.h"
 #include "boundingbox.h"
+#include "framebuffer.h"
 
 class Shader
 {
@@ -88,6 +89,30 @@ public:
 	}
 };
 
+// Matching OpenGL texture formats for the render output formats
+
+struct GLTextureFormat
+{
+	GLint internalFormat;
+	GLenum format;
+	GLenum type;
+};
+
+inline GLTextureFormat GetGLTextureFormat(const OutputFormat format) noexcept
+{
+	switch (format)
+	{
+	case OutputFormat::RGBA8: return { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE };
+	case OutputFormat::RGB16F: return { GL_RGB16F, GL_RGB, GL_HALF_FLOAT };
+	case OutputFormat::RGB32F: return { GL_RGB32F, GL_RGB, GL_FLOAT };
+	case OutputFormat::RGB8: return { GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE };
+	case OutputFormat::RGB16: return { GL_RGB16, GL_RGB, GL_UNSIGNED_SHORT };
+	case OutputFormat::YUV444: return { GL_R8, GL_RED, GL_UNSIGNED_BYTE }; // Only shows the luma plane
+	}
+
+	return { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE };
+}
+
 static void DrawBoundingBox(const BoundingBox& bbox, const vec3& color) noexcept
 {
 	glColor3f(color.x, color.y, color.z);
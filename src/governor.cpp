@@ -0,0 +1,87 @@
+#include "governor.h"
+
+bool UpdateGovernor(Governor& governor, const float frameTime) noexcept
+{
+    if (!governor.settings.enabled)
+    {
+        ResetGovernor(governor);
+        return false;
+    }
+
+    governor.smoothedFrameTime = governor.smoothedFrameTime == 0.0f ? frameTime : maths::lerp(governor.smoothedFrameTime, frameTime, 0.3f);
+
+    const float high = governor.settings.targetFrameTime * (1.0f + governor.settings.hysteresis);
+    const float low = governor.settings.targetFrameTime * (1.0f - governor.settings.hysteresis);
+
+    if (governor.smoothedFrameTime > high)
+    {
+        governor.underFrames = 0;
+
+        if (++governor.overFrames < governor.settings.settleFrames) return false;
+
+        governor.overFrames = 0;
+
+        // Degrade the first knob in priority order that still has room
+        for (uint8_t i = 0; i < GovernorKnob_Count; i++)
+        {
+            const uint8_t knob = governor.settings.priority[i];
+
+            if (governor.levels[knob] + 1 < governorLevels)
+            {
+                governor.levels[knob]++;
+                governor.smoothedFrameTime = 0.0f;
+                return true;
+            }
+        }
+    }
+    else if (governor.smoothedFrameTime < low)
+    {
+        governor.overFrames = 0;
+
+        if (++governor.underFrames < governor.settings.settleFrames) return false;
+
+        governor.underFrames = 0;
+
+        // Restore in reverse priority order
+        for (int8_t i = GovernorKnob_Count - 1; i >= 0; i--)
+        {
+            const uint8_t knob = governor.settings.priority[i];
+
+            if (governor.levels[knob] > 0)
+            {
+                governor.levels[knob]--;
+                governor.smoothedFrameTime = 0.0f;
+                return true;
+            }
+        }
+    }
+    else
+    {
+        governor.overFrames = 0;
+        governor.underFrames = 0;
+    }
+
+    return false;
+}
+
+void ResetGovernor(Governor& governor) noexcept
+{
+    for (uint8_t i = 0; i < GovernorKnob_Count; i++) governor.levels[i] = 0;
+
+    governor.smoothedFrameTime = 0.0f;
+    governor.overFrames = 0;
+    governor.underFrames = 0;
+}
+
+void ApplyGovernor(const Governor& governor, Settings& settings) noexcept
+{
+    const float* resolution = governorLadder[GovernorKnob_Resolution];
+    const float* raymarch = governorLadder[GovernorKnob_RaymarchOctaves];
+    const float* normal = governorLadder[GovernorKnob_NormalOctaves];
+    const float* steps = governorLadder[GovernorKnob_MarchSteps];
+
+    settings.resolutionScale *= resolution[governor.levels[GovernorKnob_Resolution]];
+    settings.raymarchOctaves = maths::max(1.0f, maths::ceil(settings.raymarchOctaves * raymarch[governor.levels[GovernorKnob_RaymarchOctaves]]));
+    settings.normalOctaves = maths::max(1.0f, maths::ceil(settings.normalOctaves * normal[governor.levels[GovernorKnob_NormalOctaves]]));
+    settings.maxMarchSteps = maths::max(1.0f, maths::ceil(settings.maxMarchSteps * steps[governor.levels[GovernorKnob_MarchSteps]]));
+}
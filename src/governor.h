@@ -0,0 +1,63 @@
+#pragma once
+
+#include "settings.h"
+
+// Frame time governor. It watches the measured render time and walks a degradation ladder over several
+// quality knobs to stay within a frame budget. Knobs are degraded in priority order and restored in the
+// reverse order, with a hysteresis band around the target so it does not oscillate between two levels
+
+enum GovernorKnob : uint8_t
+{
+    GovernorKnob_Resolution = 0,
+    GovernorKnob_RaymarchOctaves = 1,
+    GovernorKnob_NormalOctaves = 2,
+    GovernorKnob_MarchSteps = 3,
+    GovernorKnob_Count = 4
+};
+
+static constexpr uint8_t governorLevels = 5;
+
+// Scale applied to the base value of each knob, level 0 being full quality
+static constexpr float governorLadder[GovernorKnob_Count][governorLevels] = {
+    { 1.0f, 0.75f, 0.5f, 0.375f, 0.25f }, // Resolution
+    { 1.0f, 0.75f, 0.6f, 0.5f, 0.35f },   // Raymarch octaves
+    { 1.0f, 0.66f, 0.5f, 0.33f, 0.25f },  // Normal octaves
+    { 1.0f, 0.66f, 0.5f, 0.33f, 0.2f }    // March steps
+};
+
+static constexpr const char* governorKnobNames[GovernorKnob_Count] = { "Resolution", "Raymarch octaves", "Normal octaves", "March steps" };
+
+struct GovernorSettings
+{
+    bool enabled = false;
+
+    float targetFrameTime = 33.3f; // ms
+    float hysteresis = 0.15f;      // Fraction of the target
+    uint8_t settleFrames = 3;      // Consecutive frames out of the band before moving one step
+
+    // Degradation order, first knob is lowered first and restored last
+    uint8_t priority[GovernorKnob_Count] = { GovernorKnob_NormalOctaves,
+                                             GovernorKnob_MarchSteps,
+                                             GovernorKnob_RaymarchOctaves,
+                                             GovernorKnob_Resolution };
+};
+
+struct Governor
+{
+    GovernorSettings settings;
+
+    uint8_t levels[GovernorKnob_Count] = { 0, 0, 0, 0 };
+
+    float smoothedFrameTime = 0.0f;
+
+    uint8_t overFrames = 0;
+    uint8_t underFrames = 0;
+};
+
+// Feeds a measured frame time, returns true if a knob moved
+bool UpdateGovernor(Governor& governor, const float frameTime) noexcept;
+
+void ResetGovernor(Governor& governor) noexcept;
+
+// Writes the knobs values for the current levels in the settings, based on their full quality values
+void ApplyGovernor(const Governor& governor, Settings& settings) noexcept;
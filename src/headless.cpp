@@ -0,0 +1,712 @@
+// Headless batch renderer, renders a range of frames to disk without any window or GL context
+
+#include "batch.h"
+#include "imagewriter.h"
+#include "framestream.h"
+#include "distributed.h"
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <chrono>
+
+#ifndef _MSC_VER
+#include <signal.h>
+#endif
+
+static constexpr uint32_t maxViews = 8;
+
+// Bounds of the options without a natural limit in the type they are stored in
+static constexpr int64_t maxSamples = 1 << 20;
+static constexpr int64_t maxThreads = 4096;
+static constexpr int64_t maxWriters = 256;
+
+struct BatchSettings
+{
+    uint32_t firstFrame = 0;
+    uint32_t frameCount = 1;
+
+    ImageFileFormat format = ImageFileFormat::PPM;
+    const char* output = "frame_%04u.ppm";
+
+    uint32_t threads = 0; // 0 uses all the cores
+    uint32_t writers = 2;
+
+    // Pins the render threads to the cores starting at pinCore, and the writer ones right after them
+    bool pin = false;
+    uint32_t pinCore = 0;
+
+    // Streams the frames instead of writing files when set, "-" is stdout
+    const char* stream = nullptr;
+    OutputFormat streamFormat = OutputFormat::RGB8;
+
+    // Distributed rendering, see distributed.h
+    const char* coordinator = nullptr;
+    const char* worker = nullptr;
+    uint16_t bandRows = 0;
+
+    // Progressive render checkpointed to this file when set, see checkpoint.h
+    const char* checkpoint = nullptr;
+    float checkpointInterval = 30.0f;
+    bool resume = false;
+
+    // Extra cameras rendered along with the main one, eye then look
+    float views[maxViews][6];
+    uint32_t viewCount = 0;
+};
+
+static void PrintUsage() noexcept
+{
+    printf("Usage : OceanTracerHeadless [options]\n"
+           "  --res <width> <height>         Resolution (1280 720)\n"
+           "  --frames <first> <count>       Frame range (0 1)\n"
+           "  --time <start> <step>          Time of the first frame and time step between frames in seconds (0 0.0333)\n"
+           "  --spp <samples>                Samples per pixel (1)\n"
+           "  --eye <x> <y> <z>              Camera position (0 0 0)\n"
+           "  --look <x> <y> <z>             Camera view direction (0 0 1)\n"
+           "  --velocity <x> <y> <z>         Camera translation per second (0 0 0)\n"
+           "  --focal <mm>                   Camera focal length (50)\n"
+           "  --view <x> <y> <z> <lx> <ly> <lz>\n"
+           "                                 Adds a camera position and view direction rendered along with the main one,\n"
+           "                                 its files get a _view<n> suffix\n"
+           "  --ocean <depth> <phase> <speed> <drag>\n"
+           "  --quality <raymarch octaves> <normal octaves> <max march steps>\n"
+           "  --bounces <count>              Path traces the ocean with up to this many bounces, 0 reflects the sky (0)\n"
+           "  --region <x0> <y0> <x1> <y1>   Only renders the tiles overlapping this pixel rect, the rest stays black\n"
+           "  --format <ppm|pfm|layers>      Output format, pfm and layers are linear (ppm)\n"
+           "  --output <pattern>             printf pattern of the files, given the frame number (frame_%%04u.ppm)\n"
+           "  --threads <count>              Worker threads, 0 uses all the cores (0)\n"
+           "  --writers <count>              Image writer threads (2)\n"
+           "  --pin <first core>             Pins the worker threads to consecutive cores from this one, then the writers\n"
+           "  --stream <path|-> <rgb8|rgb16|rgbf|y4m>\n"
+           "                                 Streams raw frames to a pipe or stdout instead of writing files\n"
+           "  --coordinator <socket>         Hands the frames out to the workers connecting to the socket\n"
+           "  --bands <rows>                 Rows per job handed out by the coordinator, 0 for whole frames (0)\n"
+           "  --worker <socket>              Renders for the coordinator listening on the socket, the scene comes from it\n"
+           "  --checkpoint <file>            Accumulates the samples in a checkpoint file\n"
+           "  --checkpoint-interval <s>      Seconds between two checkpoints (30)\n"
+           "  --resume                       Continues the render saved in the checkpoint file\n");
+}
+
+// Integer option value, the whole argument has to be a number within the range of the field it goes to
+template<typename T>
+static bool ParseInteger(const char* option, const char* text, const int64_t min, const int64_t max, T& value) noexcept
+{
+    char* end = nullptr;
+    errno = 0;
+
+    const long long parsed = strtoll(text, &end, 10);
+
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < min || parsed > max)
+    {
+        fprintf(stderr, "Invalid value %s for %s, expected an integer between %lld and %lld\n", text, option,
+                static_cast<long long>(min), static_cast<long long>(max));
+        return false;
+    }
+
+    value = static_cast<T>(parsed);
+
+    return true;
+}
+
+// Decimal option value, finite and within [min, max], or (min, max] for the values that must stay above min
+static bool ParseFloat(const char* option, const char* text, const float min, const float max, float& value, const bool aboveMin = false) noexcept
+{
+    char* end = nullptr;
+    errno = 0;
+
+    const float parsed = strtof(text, &end);
+
+    if (end == text || *end != '\0' || errno == ERANGE || !isfinite(parsed) ||
+        parsed < min || (aboveMin && parsed == min) || parsed > max)
+    {
+        fprintf(stderr, "Invalid value %s for %s, expected a number in %c%g, %g]\n", text, option, aboveMin ? '(' : '[', min, max);
+        return false;
+    }
+
+    value = parsed;
+
+    return true;
+}
+
+// The cameras build their basis from the view direction and the (0, 1, 0) up vector, which needs a unit
+// direction that is not vertical
+static bool NormalizeLook(const char* option, float* look) noexcept
+{
+    const float length = sqrtf(look[0] * look[0] + look[1] * look[1] + look[2] * look[2]);
+
+    if (length > 0.0f)
+    {
+        for (uint32_t i = 0; i < 3; i++) look[i] /= length;
+
+        if (sqrtf(look[0] * look[0] + look[2] * look[2]) > 1e-3f) return true;
+    }
+
+    fprintf(stderr, "Invalid direction for %s, it must be non zero and not vertical\n", option);
+
+    return false;
+}
+
+// The output pattern is given to snprintf with the frame number as its only argument, so it needs exactly one
+// integer conversion and no length modifier
+static bool IsFramePattern(const char* pattern) noexcept
+{
+    uint32_t conversions = 0;
+
+    for (const char* c = pattern; *c != '\0'; c++)
+    {
+        if (*c != '%') continue;
+
+        if (*++c == '%') continue;
+
+        while (*c != '\0' && strchr("-+ #0", *c) != nullptr) c++;
+        while (*c >= '0' && *c <= '9') c++;
+
+        if (*c == '.')
+        {
+            c++;
+            while (*c >= '0' && *c <= '9') c++;
+        }
+
+        if (*c == '\0' || strchr("diouxX", *c) == nullptr) return false;
+
+        conversions++;
+    }
+
+    return conversions == 1;
+}
+
+static bool ParseArguments(int argc, char** argv, BatchSettings& batch, BatchScene& scene) noexcept
+{
+    // Number of values following each option
+    auto hasValues = [&](const int i, const int count) { return i + count < argc; };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--res") == 0 && hasValues(i, 2))
+        {
+            if (!ParseInteger(arg, argv[++i], 1, UINT16_MAX, scene.xres) ||
+                !ParseInteger(arg, argv[++i], 1, UINT16_MAX, scene.yres)) return false;
+        }
+        else if (strcmp(arg, "--frames") == 0 && hasValues(i, 2))
+        {
+            if (!ParseInteger(arg, argv[++i], 0, UINT32_MAX, batch.firstFrame) ||
+                !ParseInteger(arg, argv[++i], 1, UINT32_MAX - batch.firstFrame, batch.frameCount)) return false;
+        }
+        else if (strcmp(arg, "--time") == 0 && hasValues(i, 2))
+        {
+            if (!ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.startTime) ||
+                !ParseFloat(arg, argv[++i], 0.0f, FLT_MAX, scene.timeStep, true)) return false;
+        }
+        else if (strcmp(arg, "--spp") == 0 && hasValues(i, 1))
+        {
+            if (!ParseInteger(arg, argv[++i], 1, maxSamples, scene.samples)) return false;
+        }
+        else if (strcmp(arg, "--eye") == 0 && hasValues(i, 3))
+        {
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                if (!ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.eye[j])) return false;
+            }
+        }
+        else if (strcmp(arg, "--look") == 0 && hasValues(i, 3))
+        {
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                if (!ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.look[j])) return false;
+            }
+
+            if (!NormalizeLook(arg, scene.look)) return false;
+        }
+        else if (strcmp(arg, "--velocity") == 0 && hasValues(i, 3))
+        {
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                if (!ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.velocity[j])) return false;
+            }
+        }
+        else if (strcmp(arg, "--view") == 0 && hasValues(i, 6) && batch.viewCount < maxViews)
+        {
+            for (uint32_t j = 0; j < 6; j++)
+            {
+                if (!ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, batch.views[batch.viewCount][j])) return false;
+            }
+
+            if (!NormalizeLook(arg, batch.views[batch.viewCount] + 3)) return false;
+
+            batch.viewCount++;
+        }
+        else if (strcmp(arg, "--focal") == 0 && hasValues(i, 1))
+        {
+            if (!ParseFloat(arg, argv[++i], 0.0f, FLT_MAX, scene.focalLength, true)) return false;
+        }
+        else if (strcmp(arg, "--ocean") == 0 && hasValues(i, 4))
+        {
+            if (!ParseFloat(arg, argv[++i], 0.0f, FLT_MAX, scene.ocean.depth, true) ||
+                !ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.ocean.phase) ||
+                !ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.ocean.speed) ||
+                !ParseFloat(arg, argv[++i], -FLT_MAX, FLT_MAX, scene.ocean.drag)) return false;
+        }
+        else if (strcmp(arg, "--quality") == 0 && hasValues(i, 3))
+        {
+            if (!ParseInteger(arg, argv[++i], 1, MAX_WAVE_OCTAVES, scene.raymarchOctaves) ||
+                !ParseInteger(arg, argv[++i], 1, MAX_WAVE_OCTAVES, scene.normalOctaves) ||
+                !ParseInteger(arg, argv[++i], 1, UINT16_MAX, scene.maxMarchSteps)) return false;
+        }
+        else if (strcmp(arg, "--bounces") == 0 && hasValues(i, 1))
+        {
+            if (!ParseInteger(arg, argv[++i], 0, UINT8_MAX, scene.bounces)) return false;
+        }
+        else if (strcmp(arg, "--region") == 0 && hasValues(i, 4))
+        {
+            if (!ParseInteger(arg, argv[++i], 0, UINT16_MAX, scene.region.x_start) ||
+                !ParseInteger(arg, argv[++i], 0, UINT16_MAX, scene.region.y_start) ||
+                !ParseInteger(arg, argv[++i], 0, UINT16_MAX, scene.region.x_end) ||
+                !ParseInteger(arg, argv[++i], 0, UINT16_MAX, scene.region.y_end)) return false;
+        }
+        else if (strcmp(arg, "--format") == 0 && hasValues(i, 1))
+        {
+            const char* format = argv[++i];
+
+            if (strcmp(format, "ppm") == 0) batch.format = ImageFileFormat::PPM;
+            else if (strcmp(format, "pfm") == 0) batch.format = ImageFileFormat::PFM;
+            else if (strcmp(format, "layers") == 0) batch.format = ImageFileFormat::Layers;
+            else return false;
+        }
+        else if (strcmp(arg, "--output") == 0 && hasValues(i, 1))
+        {
+            batch.output = argv[++i];
+
+            if (!IsFramePattern(batch.output))
+            {
+                fprintf(stderr, "Invalid output pattern %s, expected exactly one integer conversion like %%04u\n", batch.output);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--threads") == 0 && hasValues(i, 1))
+        {
+            if (!ParseInteger(arg, argv[++i], 0, maxThreads, batch.threads)) return false;
+        }
+        else if (strcmp(arg, "--pin") == 0 && hasValues(i, 1))
+        {
+            batch.pin = true;
+
+            if (!ParseInteger(arg, argv[++i], 0, maxThreads - 1, batch.pinCore)) return false;
+        }
+        else if (strcmp(arg, "--writers") == 0 && hasValues(i, 1))
+        {
+            if (!ParseInteger(arg, argv[++i], 1, maxWriters, batch.writers)) return false;
+        }
+        else if (strcmp(arg, "--stream") == 0 && hasValues(i, 2))
+        {
+            batch.stream = argv[++i];
+
+            const char* format = argv[++i];
+
+            if (strcmp(format, "rgb8") == 0) batch.streamFormat = OutputFormat::RGB8;
+            else if (strcmp(format, "rgb16") == 0) batch.streamFormat = OutputFormat::RGB16;
+            else if (strcmp(format, "rgbf") == 0) batch.streamFormat = OutputFormat::RGB32F;
+            else if (strcmp(format, "y4m") == 0) batch.streamFormat = OutputFormat::YUV444;
+            else return false;
+        }
+        else if (strcmp(arg, "--coordinator") == 0 && hasValues(i, 1))
+        {
+            batch.coordinator = argv[++i];
+        }
+        else if (strcmp(arg, "--bands") == 0 && hasValues(i, 1))
+        {
+            if (!ParseInteger(arg, argv[++i], 0, UINT16_MAX, batch.bandRows)) return false;
+        }
+        else if (strcmp(arg, "--worker") == 0 && hasValues(i, 1))
+        {
+            batch.worker = argv[++i];
+        }
+        else if (strcmp(arg, "--checkpoint") == 0 && hasValues(i, 1))
+        {
+            batch.checkpoint = argv[++i];
+        }
+        else if (strcmp(arg, "--checkpoint-interval") == 0 && hasValues(i, 1))
+        {
+            if (!ParseFloat(arg, argv[++i], 0.0f, FLT_MAX, batch.checkpointInterval)) return false;
+        }
+        else if (strcmp(arg, "--resume") == 0)
+        {
+            batch.resume = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Tiles are identified by a 16 bit index
+    const uint32_t tileCount = ((scene.xres + 15) / 16) * ((scene.yres + 15) / 16);
+
+    if (tileCount > UINT16_MAX)
+    {
+        fprintf(stderr, "Resolution %ux%u has too many tiles, at most %u\n", scene.xres, scene.yres, UINT16_MAX);
+        return false;
+    }
+
+    return scene.xres > 0 && scene.yres > 0 && scene.samples > 0 && batch.writers > 0 &&
+           (batch.stream == nullptr || batch.coordinator == nullptr) &&
+           (batch.checkpoint == nullptr || (batch.stream == nullptr && batch.coordinator == nullptr)) &&
+           (!batch.resume || batch.checkpoint != nullptr) &&
+           (batch.viewCount == 0 || (batch.stream == nullptr && batch.coordinator == nullptr && batch.checkpoint == nullptr));
+}
+
+// Streamed frames accumulate their samples in the tiles and are resolved straight into the stream buffers
+static int StreamFrames(const BatchSettings& batch, const BatchScene& scene, FILE* log) noexcept
+{
+#ifndef _MSC_VER
+    // A consumer closing the pipe is reported as a failed write rather than killing us
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    FrameStream stream;
+
+    // Frames per 1000 seconds, clamped so a very small or very large step still fits the header
+    const uint32_t fps = std::clamp(maths::round(1000.0f / scene.timeStep), 1.0f, 1e9f);
+
+    if (!OpenFrameStream(stream, batch.stream, batch.streamFormat, scene.xres, scene.yres,
+                         batch.streamFormat == OutputFormat::YUV444, fps, 1000))
+    {
+        fprintf(stderr, "Failed to open the stream %s\n", batch.stream);
+        return 1;
+    }
+
+    BatchRenderer renderer;
+    InitBatchRenderer(renderer, scene, scene.samples > 1);
+
+    for (uint32_t frame = batch.firstFrame; frame < batch.firstFrame + batch.frameCount; frame++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        FrameBuffer* target = AcquireStreamBuffer(stream);
+
+        // The consumer is gone, the remaining frames would be rendered for nothing
+        if (stream.failed.load(std::memory_order_relaxed))
+        {
+            fprintf(log, "Frame %u : stream closed by the consumer, stopping\n", frame);
+            break;
+        }
+
+        SetBatchFrame(renderer, scene, frame);
+        RenderBatchFrame(renderer, scene, *target);
+
+        SubmitStreamFrame(stream, target);
+
+        const auto end = std::chrono::steady_clock::now();
+
+        fprintf(log, "Frame %u (%0.3f ms) : streamed\n", frame, std::chrono::duration<float, std::milli>(end - start).count());
+    }
+
+    ReleaseBatchRenderer(renderer);
+
+    if (!CloseFrameStream(stream))
+    {
+        fprintf(stderr, "Failed to write to the stream %s\n", batch.stream);
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool FileExists(const char* path) noexcept
+{
+    FILE* file = fopen(path, "rb");
+
+    if (file == nullptr) return false;
+
+    fclose(file);
+
+    return true;
+}
+
+// Long renders accumulate in the checkpoint file, so a killed render can resume from its last checkpoint
+static int WriteCheckpointedFrames(const BatchSettings& batch, const BatchScene& scene, ImageWriter& writer, FILE* log) noexcept
+{
+    BatchRenderer renderer;
+    InitBatchRenderer(renderer, scene, true);
+
+    Checkpoint checkpoint;
+    checkpoint.interval = batch.checkpointInterval;
+
+    bool resumed = false;
+
+    if (!OpenCheckpoint(checkpoint, batch.checkpoint, scene, renderer.tiles, batch.resume, resumed))
+    {
+        fprintf(stderr, "Failed to map the checkpoint %s\n", batch.checkpoint);
+        ReleaseBatchRenderer(renderer);
+        return 1;
+    }
+
+    if (batch.resume && !resumed) fprintf(log, "No checkpoint of this scene in %s, starting over\n", batch.checkpoint);
+
+    const bool layers = batch.format == ImageFileFormat::Layers;
+
+    // Frames before the checkpointed one are done, unless their file never made it to the disk
+    const uint32_t checkpointFrame = resumed ? checkpoint.header->frame : ~0u;
+
+    // Those missing files are rendered apart, so the accumulation of the checkpointed frame survives them
+    BatchRenderer missingRenderer;
+    std::vector<uint32_t> missingSamples;
+
+    for (uint32_t frame = batch.firstFrame; frame < batch.firstFrame + batch.frameCount; frame++)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), batch.output, frame);
+
+        const bool done = frame < checkpointFrame && checkpointFrame != ~0u;
+
+        if (done && FileExists(path))
+        {
+            fprintf(log, "Frame %u : already rendered\n", frame);
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        BatchRenderer* target = &renderer;
+        uint32_t* tileSamples = checkpoint.tileSamples;
+
+        if (done)
+        {
+            if (missingSamples.empty()) InitBatchRenderer(missingRenderer, scene, true);
+
+            missingSamples.assign(checkpoint.header->tileCount, 0);
+
+            target = &missingRenderer;
+            tileSamples = missingSamples.data();
+        }
+        else
+        {
+            BeginCheckpointFrame(checkpoint, frame);
+
+            uint32_t samples = 0;
+            for (uint32_t t = 0; t < checkpoint.header->tileCount; t++) samples += checkpoint.tileSamples[t];
+
+            if (samples > 0) fprintf(log, "Frame %u : resuming from %0.1f samples per tile\n", frame, samples / static_cast<float>(checkpoint.header->tileCount));
+        }
+
+        ImageBuffer* image = AcquireImageBuffer(writer);
+
+        SetBatchFrame(*target, scene, frame);
+        RenderBatchTiles(*target, scene, tileSamples, [&]() { if (!done) UpdateCheckpoint(checkpoint, false); });
+
+        GatherBatchTiles(*target, image->beauty);
+
+        // The tiles only accumulate the beauty
+        if (layers) RenderBatchLayers(*target, image->normal, image->depth);
+
+        if (!done) UpdateCheckpoint(checkpoint, true);
+
+        SubmitImage(writer, image, path, batch.format);
+
+        const auto end = std::chrono::steady_clock::now();
+
+        fprintf(log, "Frame %u (%0.3f ms) : %s\n", frame, std::chrono::duration<float, std::milli>(end - start).count(), path);
+    }
+
+    if (!missingSamples.empty()) ReleaseBatchRenderer(missingRenderer);
+
+    CloseCheckpoint(checkpoint, renderer.tiles);
+    ReleaseBatchRenderer(renderer);
+
+    return 0;
+}
+
+// Output path of a view, the extra ones get a suffix before the extension
+static void ViewPath(char* path, const size_t size, const char* pattern, const uint32_t frame, const uint32_t view) noexcept
+{
+    snprintf(path, size, pattern, frame);
+
+    if (view == 0) return;
+
+    char* extension = strrchr(path, '.');
+    const char* separator = strrchr(path, '/');
+
+    if (extension == nullptr || (separator != nullptr && extension < separator)) extension = path + strlen(path);
+
+    char suffix[1024];
+    snprintf(suffix, sizeof(suffix), "_view%u%s", view, extension);
+    snprintf(extension, size - (extension - path), "%s", suffix);
+}
+
+// All the cameras render the same frame together and each one gets its own file
+static int WriteViewFrames(const BatchSettings& batch, const BatchScene& scene, ImageWriter& writer, FILE* log) noexcept
+{
+    BatchRenderer renderer;
+    InitBatchRenderer(renderer, scene, false);
+
+    for (uint32_t v = 0; v < batch.viewCount; v++) AddBatchView(renderer, scene, batch.views[v], batch.views[v] + 3);
+
+    const uint32_t viewCount = batch.viewCount + 1;
+    const bool layers = batch.format == ImageFileFormat::Layers;
+
+    ImageBuffer* images[maxViews + 1];
+    float* beauty[maxViews + 1];
+    float* normal[maxViews + 1];
+    float* depth[maxViews + 1];
+
+    for (uint32_t frame = batch.firstFrame; frame < batch.firstFrame + batch.frameCount; frame++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t v = 0; v < viewCount; v++)
+        {
+            images[v] = AcquireImageBuffer(writer);
+
+            beauty[v] = images[v]->beauty;
+            normal[v] = images[v]->normal;
+            depth[v] = images[v]->depth;
+        }
+
+        SetBatchFrame(renderer, scene, frame);
+        RenderBatchViews(renderer, scene, beauty, layers ? normal : nullptr, layers ? depth : nullptr);
+
+        char path[1024];
+
+        for (uint32_t v = 0; v < viewCount; v++)
+        {
+            ViewPath(path, sizeof(path), batch.output, frame, v);
+            SubmitImage(writer, images[v], path, batch.format);
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+
+        fprintf(log, "Frame %u (%0.3f ms) : %u views\n", frame, std::chrono::duration<float, std::milli>(end - start).count(), viewCount);
+    }
+
+    ReleaseBatchRenderer(renderer);
+
+    return 0;
+}
+
+static int WriteFrames(const BatchSettings& batch, const BatchScene& scene, const int32_t writerCore, FILE* log) noexcept
+{
+    // One frame more than writers so the next frame can render while they are all busy
+    ImageWriter writer;
+    StartImageWriter(writer, batch.writers, batch.writers + batch.viewCount + 1, scene.xres, scene.yres,
+                     batch.format == ImageFileFormat::Layers, writerCore);
+
+    if (batch.coordinator != nullptr)
+    {
+        CoordinatorSettings coordinator;
+        coordinator.socketPath = batch.coordinator;
+        coordinator.firstFrame = batch.firstFrame;
+        coordinator.frameCount = batch.frameCount;
+        coordinator.bandRows = batch.bandRows;
+        coordinator.output = batch.output;
+        coordinator.format = batch.format;
+
+        const bool success = RunCoordinator(coordinator, scene, writer, log);
+
+        StopImageWriter(writer);
+
+        if (!success) fprintf(stderr, "Failed to coordinate the render on %s\n", batch.coordinator);
+
+        return success && writer.failures.load() == 0 ? 0 : 1;
+    }
+
+    if (batch.checkpoint != nullptr || batch.viewCount > 0)
+    {
+        const int result = batch.viewCount > 0 ? WriteViewFrames(batch, scene, writer, log) :
+                                                 WriteCheckpointedFrames(batch, scene, writer, log);
+
+        StopImageWriter(writer);
+
+        return result != 0 || writer.failures.load() > 0 ? 1 : 0;
+    }
+
+    BatchRenderer renderer;
+    InitBatchRenderer(renderer, scene, false);
+
+    const bool layers = batch.format == ImageFileFormat::Layers;
+
+    for (uint32_t frame = batch.firstFrame; frame < batch.firstFrame + batch.frameCount; frame++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        ImageBuffer* image = AcquireImageBuffer(writer);
+
+        SetBatchFrame(renderer, scene, frame);
+        RenderBatchRows(renderer, scene, 0, scene.yres, image->beauty, layers ? image->normal : nullptr, layers ? image->depth : nullptr);
+
+        char path[1024];
+        snprintf(path, sizeof(path), batch.output, frame);
+
+        // Encoding and writing happen on the writer threads while the next frame renders
+        SubmitImage(writer, image, path, batch.format);
+
+        const auto end = std::chrono::steady_clock::now();
+
+        fprintf(log, "Frame %u (%0.3f ms) : %s\n", frame, std::chrono::duration<float, std::milli>(end - start).count(), path);
+    }
+
+    ReleaseBatchRenderer(renderer);
+
+    StopImageWriter(writer);
+
+    return writer.failures.load() > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+    BatchSettings batch;
+    BatchScene scene;
+
+    if (!ParseArguments(argc, argv, batch, scene))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const size_t threads = batch.threads > 0 ? batch.threads : tbb::info::default_concurrency();
+    tbb::global_control threadControl(tbb::global_control::max_allowed_parallelism, threads);
+
+    // Everything renders in an arena of exactly the requested size, the main thread being one of its threads
+    ThreadSettings threadSettings;
+    threadSettings.renderThreads = threads;
+    threadSettings.pin = batch.pin;
+    threadSettings.firstCore = batch.pinCore;
+
+    ThreadPools pools;
+    InitThreadPools(pools, threadSettings);
+
+    const int32_t writerCore = batch.pin ? static_cast<int32_t>(GetNextFreeCore(pools)) : -1;
+
+    int result = 0;
+
+    RunRender(pools, [&]()
+        {
+            if (batch.worker != nullptr)
+            {
+                result = RunWorker(batch.worker, stdout) ? 0 : 1;
+
+                if (result != 0) fprintf(stderr, "Lost the coordinator on %s\n", batch.worker);
+            }
+            else if (batch.stream != nullptr)
+            {
+                // The frames own stdout when streamed to it
+                result = StreamFrames(batch, scene, strcmp(batch.stream, "-") == 0 ? stderr : stdout);
+            }
+            else
+            {
+                result = WriteFrames(batch, scene, writerCore, stdout);
+            }
+        });
+
+    ReleaseThreadPools(pools);
+
+    return result;
+}
@@ -0,0 +1,86 @@
+#include "imageio.h"
+
+#include "maths.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool WritePPM(const char* path, const float* pixels, const uint16_t xres, const uint16_t yres) noexcept
+{
+    constexpr float gamma = 1.0f / 2.2f;
+
+    FILE* file = fopen(path, "wb");
+
+    if (file == nullptr) return false;
+
+    fprintf(file, "P6\n%u %u\n255\n", xres, yres);
+
+    uint8_t* row = new uint8_t[xres * 3];
+
+    bool success = true;
+
+    for (uint32_t y = 0; y < yres && success; y++)
+    {
+        for (uint32_t x = 0; x < xres * 3; x++)
+        {
+            const float value = maths::pow(maths::clamp(pixels[x + y * xres * 3]), gamma);
+
+            row[x] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+
+        success = fwrite(row, 3, xres, file) == xres;
+    }
+
+    delete[] row;
+
+    return fclose(file) == 0 && success;
+}
+
+bool WritePFM(const char* path, const float* pixels, const uint16_t xres, const uint16_t yres) noexcept
+{
+    FILE* file = fopen(path, "wb");
+
+    if (file == nullptr) return false;
+
+    // A negative scale means little endian
+    fprintf(file, "PF\n%u %u\n-1.0\n", xres, yres);
+
+    bool success = true;
+
+    // Rows are stored bottom to top
+    for (int y = yres - 1; y >= 0 && success; y--)
+    {
+        success = fwrite(pixels + static_cast<size_t>(y) * xres * 3, sizeof(float) * 3, xres, file) == xres;
+    }
+
+    return fclose(file) == 0 && success;
+}
+
+bool WriteLayers(const char* path, const ImageLayer* layers, const uint32_t layerCount, const uint16_t xres, const uint16_t yres) noexcept
+{
+    FILE* file = fopen(path, "wb");
+
+    if (file == nullptr) return false;
+
+    const uint32_t header[5] = { 0x464C544F /* OTLF */, 1, xres, yres, layerCount };
+
+    bool success = fwrite(header, sizeof(header), 1, file) == 1;
+
+    for (uint32_t i = 0; i < layerCount && success; i++)
+    {
+        char name[32] = { 0 };
+        strncpy(name, layers[i].name, sizeof(name) - 1);
+
+        success = fwrite(name, sizeof(name), 1, file) == 1 &&
+                  fwrite(&layers[i].channels, sizeof(uint32_t), 1, file) == 1;
+    }
+
+    for (uint32_t i = 0; i < layerCount && success; i++)
+    {
+        const size_t count = static_cast<size_t>(xres) * yres * layers[i].channels;
+
+        success = fwrite(layers[i].data, sizeof(float), count, file) == count;
+    }
+
+    return fclose(file) == 0 && success;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+// Image files for the offline renders, all the writers take linear float planes and return false if the
+// file could not be written
+
+// Binary 8 bits ppm from interleaved RGB, gamma corrected on the way
+bool WritePPM(const char* path, const float* pixels, const uint16_t xres, const uint16_t yres) noexcept;
+
+// Little endian pfm from interleaved RGB
+bool WritePFM(const char* path, const float* pixels, const uint16_t xres, const uint16_t yres) noexcept;
+
+struct ImageLayer
+{
+    const char* name;
+    const float* data; // Interleaved channels
+    uint32_t channels;
+};
+
+// Uncompressed layered float image, everything little endian :
+// "OTLF", uint32 version, uint32 xres, uint32 yres, uint32 layer count,
+// then per layer a 32 bytes zero padded name and a uint32 channel count,
+// then the layers data one after the other, top to bottom
+bool WriteLayers(const char* path, const ImageLayer* layers, const uint32_t layerCount, const uint16_t xres, const uint16_t yres) noexcept;
@@ -0,0 +1,116 @@
+#include "imagewriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool WriteImage(const ImageJob& job) noexcept
+{
+    const ImageBuffer& buffer = *job.buffer;
+
+    switch (job.format)
+    {
+    case ImageFileFormat::PPM:
+        return WritePPM(job.path, buffer.beauty, buffer.xres, buffer.yres);
+    case ImageFileFormat::PFM:
+        return WritePFM(job.path, buffer.beauty, buffer.xres, buffer.yres);
+    case ImageFileFormat::Layers:
+    {
+        const ImageLayer layers[3] = { { "beauty", buffer.beauty, 3 },
+                                       { "normal", buffer.normal, 3 },
+                                       { "depth", buffer.depth, 1 } };
+
+        return WriteLayers(job.path, layers, 3, buffer.xres, buffer.yres);
+    }
+    }
+
+    return false;
+}
+
+static void WriterLoop(ImageWriter& writer, const int32_t core) noexcept
+{
+    if (core >= 0) PinCurrentThread(core);
+
+    while (true)
+    {
+        ImageJob job;
+        writer.jobs.pop(job);
+
+        if (job.buffer == nullptr) break;
+
+        if (!WriteImage(job))
+        {
+            fprintf(stderr, "Failed to write %s\n", job.path);
+            writer.failures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        writer.freeBuffers.push(job.buffer);
+    }
+}
+
+void StartImageWriter(ImageWriter& writer,
+                      const uint32_t threadCount,
+                      const uint32_t bufferCount,
+                      const uint16_t xres,
+                      const uint16_t yres,
+                      const bool layers,
+                      const int32_t firstCore) noexcept
+{
+    for (uint32_t i = 0; i < bufferCount; i++)
+    {
+        ImageBuffer* buffer = new ImageBuffer;
+        buffer->xres = xres;
+        buffer->yres = yres;
+        buffer->beauty = new float[xres * yres * 3]();
+
+        if (layers)
+        {
+            buffer->normal = new float[xres * yres * 3]();
+            buffer->depth = new float[xres * yres]();
+        }
+
+        writer.buffers.push_back(buffer);
+        writer.freeBuffers.push(buffer);
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++) writer.threads.emplace_back(WriterLoop, std::ref(writer), firstCore >= 0 ? firstCore + static_cast<int32_t>(i) : -1);
+}
+
+void StopImageWriter(ImageWriter& writer) noexcept
+{
+    // One stop job per thread, queued behind the images still to be written
+    for (size_t i = 0; i < writer.threads.size(); i++) writer.jobs.push(ImageJob());
+
+    for (std::thread& thread : writer.threads) thread.join();
+
+    writer.threads.clear();
+    writer.freeBuffers.clear();
+
+    for (ImageBuffer* buffer : writer.buffers)
+    {
+        delete[] buffer->beauty;
+        delete[] buffer->normal;
+        delete[] buffer->depth;
+        delete buffer;
+    }
+
+    writer.buffers.clear();
+}
+
+ImageBuffer* AcquireImageBuffer(ImageWriter& writer) noexcept
+{
+    ImageBuffer* buffer = nullptr;
+    writer.freeBuffers.pop(buffer);
+
+    return buffer;
+}
+
+void SubmitImage(ImageWriter& writer, ImageBuffer* buffer, const char* path, const ImageFileFormat format) noexcept
+{
+    ImageJob job;
+    job.buffer = buffer;
+    job.format = format;
+    strncpy(job.path, path, sizeof(job.path) - 1);
+    job.path[sizeof(job.path) - 1] = '\0';
+
+    writer.jobs.push(job);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "imageio.h"
+#include "threads.h"
+
+#include "tbb/concurrent_queue.h"
+
+#include <thread>
+#include <vector>
+#include <atomic>
+
+// Background image writer pool. Finished frames are copied into pooled buffers and handed to the writer
+// threads, which encode and write them while the next frame renders. Acquiring a buffer blocks when they
+// are all in flight, which keeps the renderer from running away from a slow disk
+
+enum class ImageFileFormat : uint8_t
+{
+    PPM = 0,
+    PFM = 1,
+    Layers = 2
+};
+
+struct ImageBuffer
+{
+    float* beauty = nullptr; // Linear RGB
+    float* normal = nullptr; // RGB, only allocated by a writer started for the layered format
+    float* depth = nullptr;  // Only allocated by a writer started for the layered format
+
+    uint16_t xres = 0;
+    uint16_t yres = 0;
+};
+
+struct ImageJob
+{
+    ImageBuffer* buffer = nullptr; // Null stops the worker
+    ImageFileFormat format = ImageFileFormat::PPM;
+    char path[1024];
+};
+
+struct ImageWriter
+{
+    std::vector<std::thread> threads;
+
+    tbb::concurrent_bounded_queue<ImageJob> jobs;
+    tbb::concurrent_bounded_queue<ImageBuffer*> freeBuffers;
+
+    std::vector<ImageBuffer*> buffers;
+
+    std::atomic<uint32_t> failures{ 0 };
+};
+
+// Allocates bufferCount buffers of the given resolution once, they are recycled afterwards. The normal and depth
+// planes are only allocated with layers. With a first core the writer threads are pinned to the cores starting
+// there, out of the way of the render ones
+void StartImageWriter(ImageWriter& writer,
+                      const uint32_t threadCount,
+                      const uint32_t bufferCount,
+                      const uint16_t xres,
+                      const uint16_t yres,
+                      const bool layers,
+                      const int32_t firstCore = -1) noexcept;
+
+// Waits for all the submitted images to be written and releases everything, the buffers must have been submitted
+void StopImageWriter(ImageWriter& writer) noexcept;
+
+// Blocks until a buffer is free
+ImageBuffer* AcquireImageBuffer(ImageWriter& writer) noexcept;
+
+// The buffer goes back to the pool once written
+void SubmitImage(ImageWriter& writer, ImageBuffer* buffer, const char* path, const ImageFileFormat format) noexcept;
@@ -118,4 +118,20 @@ inline vec3 transform_dir(const vec3& v, const mat44& m) noexcept
     return vec3(v.x * m[0][0] + v.y * m[0][1] + v.z * m[0][2],
         v.x * m[1][0] + v.y * m[1][1] + v.z * m[1][2],
         v.x * m[2][0] + v.y * m[2][1] + v.z * m[2][2]);
+}
+
+// Inverse of the upper 3x3 part, the one transform_dir uses
+inline mat44 inverse_linear(const mat44& m) noexcept
+{
+    const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    const float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    const float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+
+    const float det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+    const float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+
+    return mat44(c00 * invDet, (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet, (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet, 0.0f,
+        c01 * invDet, (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet, (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet, 0.0f,
+        c02 * invDet, (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet, (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f);
 }
\ No newline at end of file
@@ -111,12 +111,16 @@ namespace maths
 
     FORCEINLINE float log10(const float x) noexcept { return ::log10f(x); }
 
+    FORCEINLINE float log2(const float x) noexcept { return ::log2f(x); }
+
     FORCEINLINE float pow(const float x, const float y) noexcept { return ::powf(x, y); }
 
     FORCEINLINE float floor(const float x) noexcept { return ::floorf(x); }
 
     FORCEINLINE float ceil(const float x) noexcept { return ::ceilf(x); }
 
+    FORCEINLINE float round(const float x) noexcept { return ::roundf(x); }
+
     FORCEINLINE float frac(const float x) noexcept { return x - ::floorf(x); }
     
     FORCEINLINE float acos(const float x) noexcept { return ::acosf(x); }
@@ -0,0 +1,67 @@
+#include "numa.h"
+
+#include <string.h>
+#include <algorithm>
+
+void InitNumaTopology(NumaTopology& topology, const uint32_t maxThreads) noexcept
+{
+    topology.arenas.clear();
+
+    // Only reports the actual nodes when the tbbbind library is available, a single node otherwise
+    const std::vector<tbb::numa_node_id> nodes = tbb::info::numa_nodes();
+
+    if (nodes.size() < 2) return;
+
+    topology.arenas.reserve(nodes.size());
+
+    // A thread budget is split evenly between the nodes, each one otherwise gets all of its cores
+    const uint32_t nodeThreads = maxThreads > 0 ? std::max<uint32_t>(1, maxThreads / nodes.size()) : 0;
+
+    for (const tbb::numa_node_id node : nodes)
+    {
+        tbb::task_arena::constraints constraints(node);
+
+        if (nodeThreads > 0) constraints.set_max_concurrency(std::min<int>(nodeThreads, tbb::info::default_concurrency(node)));
+
+        topology.arenas.emplace_back(constraints);
+    }
+}
+
+void RunOnNumaNodes(NumaTopology& topology, const std::function<void(const uint32_t node)>& function) noexcept
+{
+    const uint32_t count = GetNumaNodeCount(topology);
+
+    std::vector<tbb::task_group> groups(count);
+
+    for (uint32_t node = 0; node < count; node++)
+    {
+        topology.arenas[node].execute([&, node]() { groups[node].run([&, node]() { function(node); }); });
+    }
+
+    for (uint32_t node = 0; node < count; node++)
+    {
+        topology.arenas[node].execute([&, node]() { groups[node].wait(); });
+    }
+}
+
+void FirstTouchRows(NumaTopology& topology, void* data, const size_t rowBytes, const uint32_t yres, const uint32_t planes) noexcept
+{
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+
+    const uint32_t count = GetNumaNodeCount(topology);
+
+    RunOnNumaNodes(topology, [&](const uint32_t node)
+        {
+            // First row of the band of the node, and of the next one
+            const uint32_t yStart = (static_cast<uint64_t>(node) * yres + count - 1) / count;
+            const uint32_t yEnd = (static_cast<uint64_t>(node + 1) * yres + count - 1) / count;
+
+            tbb::parallel_for(tbb::blocked_range<uint32_t>(yStart, yEnd), [&](const tbb::blocked_range<uint32_t>& r)
+                {
+                    for (uint32_t plane = 0; plane < planes; plane++)
+                    {
+                        memset(bytes + (plane * yres + r.begin()) * rowBytes, 0, (r.end() - r.begin()) * rowBytes);
+                    }
+                });
+        });
+}
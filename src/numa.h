@@ -0,0 +1,44 @@
+#pragma once
+
+#include "decl.h"
+#include "tbb/tbb.h"
+
+#include <functional>
+#include <vector>
+
+// NUMA aware scheduling for multi socket machines. There is one task arena per NUMA node, and each node owns a
+// contiguous band of rows of the frame. The tiles of a band are rendered by the threads of its node, and the
+// framebuffer rows and the tile buffers are first touched by them, so the pages land in the memory local to the
+// node instead of crossing the interconnect on every write. On single node machines there are no arenas and
+// everything runs through the default one
+
+struct NumaTopology
+{
+    std::vector<tbb::task_arena> arenas; // One per node, empty when there is a single node
+};
+
+// Caps the total number of threads of the node arenas when maxThreads is set
+void InitNumaTopology(NumaTopology& topology, const uint32_t maxThreads = 0) noexcept;
+
+FORCEINLINE bool IsNumaEnabled(const NumaTopology* topology) noexcept
+{
+    return topology != nullptr && topology->arenas.size() > 1;
+}
+
+FORCEINLINE uint32_t GetNumaNodeCount(const NumaTopology& topology) noexcept
+{
+    return topology.arenas.size();
+}
+
+// Contiguous bands of rows, as even as possible
+FORCEINLINE uint32_t GetNumaRowNode(const NumaTopology& topology, const uint32_t y, const uint32_t yres) noexcept
+{
+    return static_cast<uint64_t>(y) * GetNumaNodeCount(topology) / yres;
+}
+
+// Runs the function for every node in its own arena, all the nodes at the same time, and waits for all of them
+void RunOnNumaNodes(NumaTopology& topology, const std::function<void(const uint32_t node)>& function) noexcept;
+
+// Clears the rows of a freshly allocated buffer from the nodes owning them. Planar buffers have their planes one
+// after the other, each of them yres rows of rowBytes
+void FirstTouchRows(NumaTopology& topology, void* data, const size_t rowBytes, const uint32_t yres, const uint32_t planes = 1) noexcept;
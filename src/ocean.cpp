@@ -1,13 +1,17 @@
 #include "ocean.h"
 
-bool Raymarch(const Ocean& ocean, RayHit& rayhit, const float time) noexcept
+bool Raymarch(const Ocean& ocean, 
+              RayHit& rayhit, 
+              const float time, 
+              const uint8_t iterations, 
+              const uint16_t maxSteps) noexcept
 {
     vec3 position = rayhit.hit.pos;
     float h = 0.0f;
 
-    for(uint16_t i = 0; i < 300; i++)
+    for(uint16_t i = 0; i < maxSteps; i++)
     {
-        h = Wave(ocean, vec2(position.x, position.z) * 0.1f, ITERATIONS_RAYMARCH, time) * ocean.depth - ocean.depth;
+        h = Wave(ocean, vec2(position.x, position.z) * 0.1f, iterations, time) * ocean.depth - ocean.depth;
         if(h + 0.01f > position.y)
         {
             rayhit.hit.pos = position;
@@ -33,8 +37,59 @@ vec2 WaveDx(const vec2& position, const vec2& direction, const float speed, cons
     return vec2(wave, -dx);
 }
 
+void BuildWaveTable(WaveTable& table, const Ocean& ocean, const float time, const uint8_t octaves) noexcept
+{
+    table.time = time;
+    table.count = std::min<uint8_t>(octaves, MAX_WAVE_OCTAVES);
+
+    // Same sequence as Wave
+    float iter = 0.0f;
+    float phase = ocean.phase;
+    float speed = ocean.speed;
+    float weight = 1.0f;
+
+    table.weightSums[0] = 0.0f;
+
+    for (uint8_t i = 0; i < table.count; i++)
+    {
+        WaveOctave& octave = table.octaves[i];
+
+        octave.direction = vec2(sin(iter), cos(iter));
+        octave.offset = normalize(octave.direction);
+        octave.frequency = phase;
+        octave.timeshift = time * speed;
+        octave.weight = weight;
+
+        table.weightSums[i + 1] = table.weightSums[i] + weight;
+
+        iter += 12.0f;
+        weight = maths::lerp(weight, 0.0f, 0.2f);
+        phase *= 1.18f;
+        speed *= 1.07f;
+    }
+}
+
 float Wave(const Ocean& ocean, const vec2& position, const uint8_t iterations, const float time) noexcept
 {
+    if (ocean.waves != nullptr && ocean.waves->time == time && iterations <= ocean.waves->count)
+    {
+        const WaveTable& table = *ocean.waves;
+
+        vec2 pos = position;
+        float w = 0.0f;
+
+        for (uint8_t i = 0; i < iterations; i++)
+        {
+            const WaveOctave& octave = table.octaves[i];
+
+            const vec2 res = WaveDx(pos, octave.direction, 1.0f, octave.frequency, octave.timeshift);
+            pos += octave.offset * res.y * octave.weight * ocean.drag;
+            w += res.x * octave.weight;
+        }
+
+        return w / table.weightSums[iterations];
+    }
+
     vec2 pos = position;
     float iter = 0.0f;
     float phase = ocean.phase;
@@ -59,12 +114,12 @@ float Wave(const Ocean& ocean, const vec2& position, const uint8_t iterations, c
     return w / ws;
 }
 
-vec3 WaveNormal(const Ocean& ocean, const vec2& position, const float time, const float e) noexcept
+vec3 WaveNormal(const Ocean& ocean, const vec2& position, const float time, const uint8_t iterations, const float e) noexcept
 {
     const vec2 ex = vec2(e, 0.0f);
-    const float H = Wave(ocean, position * 0.1f, ITERATIONS_NORMAL, time) * ocean.depth - ocean.depth;
+    const float H = Wave(ocean, position * 0.1f, iterations, time) * ocean.depth - ocean.depth;
     const vec3 a = vec3(position.x, H, position.y);
     
-    return normalize(cross(a - vec3(position.x - e, Wave(ocean, position * 0.1f - ex, ITERATIONS_NORMAL, time) * ocean.depth - ocean.depth, position.y),
-                           a - vec3(position.x, Wave(ocean, position * 0.1f + vec2(ex.y, ex.x) * 0.1f, ITERATIONS_NORMAL, time) * ocean.depth - ocean.depth, position.y + e)));
+    return normalize(cross(a - vec3(position.x - e, Wave(ocean, position * 0.1f - ex, iterations, time) * ocean.depth - ocean.depth, position.y),
+                           a - vec3(position.x, Wave(ocean, position * 0.1f + vec2(ex.y, ex.x) * 0.1f, iterations, time) * ocean.depth - ocean.depth, position.y + e)));
 }
\ No newline at end of file
@@ -3,26 +3,64 @@
 #include "boundingbox.h"
 #include "vec2.h"
 
+// Default quality, these can be lowered at runtime through the settings
 #define ITERATIONS_NORMAL 48
 #define ITERATIONS_RAYMARCH 12
+#define MAX_RAYMARCH_STEPS 300
+
+// Octaves of the waves evaluated once per frame, see WaveTable
+#define MAX_WAVE_OCTAVES 64
+
+struct WaveOctave
+{
+    vec2 direction;
+    vec2 offset;     // Normalized direction the position drifts along
+    float frequency;
+    float timeshift; // Time times the speed of the octave
+    float weight;
+};
+
+// Per octave constants of the waves at a given time. They only depend on the ocean parameters and the time,
+// so they are built once per frame and shared by every ray of every view instead of being recomputed with
+// a sin and a cos per octave for each wave evaluation
+struct WaveTable
+{
+    WaveOctave octaves[MAX_WAVE_OCTAVES];
+    float weightSums[MAX_WAVE_OCTAVES + 1]; // Sum of the weights of the first n octaves
+
+    float time = 0.0f;
+    uint8_t count = 0;
+};
 
 struct alignas(16) Ocean
 {
     BoundingBox bbox;
+
+    // Used by Wave when built for the time it is evaluated at
+    const WaveTable* waves = nullptr;
     
     float depth = 2.0f;
     float phase = 6.0f;
     float speed = 2.0f;
     float drag = 0.048;
 
+    // Water body seen by the path tracer, the light scattered back up through the surface is a diffuse lobe
+    vec3 albedo = vec3(0.02f, 0.06f, 0.08f);
+    float ior = 1.33f;
 };
     
-bool Raymarch(const Ocean& ocean, RayHit& rayhit, const float time) noexcept;
+bool Raymarch(const Ocean& ocean, 
+              RayHit& rayhit, 
+              const float time, 
+              const uint8_t iterations = ITERATIONS_RAYMARCH, 
+              const uint16_t maxSteps = MAX_RAYMARCH_STEPS) noexcept;
 
 bool Intersect(const Ocean& ocean, RayHit& rayhit) noexcept;
 
+void BuildWaveTable(WaveTable& table, const Ocean& ocean, const float time, const uint8_t octaves) noexcept;
+
 vec2 WaveDx(const vec2& position, const vec2& direction, const float speed, const float freq, const float timeshift) noexcept;
 
 float Wave(const Ocean& ocean, const vec2& position, const uint8_t iterations, const float time) noexcept;
 
-vec3 WaveNormal(const Ocean& ocean, const vec2& position, const float time, const float e = 0.01f) noexcept;
\ No newline at end of file
+vec3 WaveNormal(const Ocean& ocean, const vec2& position, const float time, const uint8_t iterations = ITERATIONS_NORMAL, const float e = 0.01f) noexcept;
\ No newline at end of file
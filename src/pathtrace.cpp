@@ -0,0 +1,270 @@
+#include "pathtrace.h"
+
+// Offset along the normal of the next ray origin, above the tolerance of the raymarcher
+static constexpr float surfaceOffset = 0.05f;
+
+// State of the paths of a tile, as arrays so the sky can be evaluated 8 paths at a time
+struct PathQueue
+{
+    alignas(32) float origin[3][maxTilePaths];
+    alignas(32) float direction[3][maxTilePaths];
+    alignas(32) float throughput[3][maxTilePaths];
+    alignas(32) float lobePdf[maxTilePaths]; // Of the direction when it comes from the diffuse lobe, 0 for the specular one
+    alignas(32) float envPdf[maxTilePaths];  // Of the env map sampler for the same direction, 0 without one
+
+    uint16_t pixel[maxTilePaths]; // Index in the tile
+    uint32_t count = 0;
+};
+
+FORCEINLINE void PushPath(PathQueue& queue, const vec3& origin, const vec3& direction, const vec3& throughput, const float lobePdf, const float envPdf, const uint16_t pixel) noexcept
+{
+    const uint32_t i = queue.count++;
+
+    queue.origin[0][i] = origin.x;
+    queue.origin[1][i] = origin.y;
+    queue.origin[2][i] = origin.z;
+    queue.direction[0][i] = direction.x;
+    queue.direction[1][i] = direction.y;
+    queue.direction[2][i] = direction.z;
+    queue.throughput[0][i] = throughput.x;
+    queue.throughput[1][i] = throughput.y;
+    queue.throughput[2][i] = throughput.z;
+    queue.lobePdf[i] = lobePdf;
+    queue.envPdf[i] = envPdf;
+    queue.pixel[i] = pixel;
+}
+
+// The lanes past the count read stale entries of the queue, they are computed but never written back
+static void ShadeMisses(const PathQueue& misses, const Sky& sky, vec3* radiance) noexcept
+{
+    alignas(32) float colors[3][8];
+
+    const vfloat8 zero = _mm256_setzero_ps();
+    const vfloat8 one = set8(1.0f);
+
+    for (uint32_t i = 0; i < misses.count; i += 8)
+    {
+        const vfloat8 dx = load8(misses.direction[0] + i);
+        const vfloat8 dy = load8(misses.direction[1] + i);
+        const vfloat8 dz = load8(misses.direction[2] + i);
+
+        vfloat8 r, g, b;
+        SampleSky8(dx, dy, dz, sky, r, g, b);
+
+        // After a diffuse bounce the sky has already been sampled explicitly, only the share of the lobe sampling
+        // remains. The sun is sampled by both light strategies, the rest of the sky only by the env map one. The
+        // pdf of the sun sampling is its lobe intensity up to a constant
+        const vfloat8 lobePdf = load8(misses.lobePdf + i);
+        const vfloat8 envPdf = load8(misses.envPdf + i);
+        const vfloat8 intensity = SampleSunIntensity8(dx, dy, dz, sky.sun);
+        const vfloat8 sunPdf = mul8(intensity, set8((sunExponent + 1.0f) / (2.0f * maths::constants::pi)));
+
+        const vfloat8 diffuse = gt8(lobePdf, zero);
+        const vfloat8 lobePdf2 = mul8(lobePdf, lobePdf);
+        const vfloat8 gradientDenominator = fmadd8(envPdf, envPdf, lobePdf2);
+
+        const vfloat8 sunWeight = select8(diffuse, div8(lobePdf2, fmadd8(sunPdf, sunPdf, gradientDenominator)), one);
+        const vfloat8 gradientWeight = select8(diffuse, div8(lobePdf2, gradientDenominator), one);
+
+        // Weighted sum of the two parts, the sun one being its intensity times its color
+        const vfloat8 sunShare = mul8(intensity, sub8(sunWeight, gradientWeight));
+
+        r = fmadd8(sunShare, set8(sky.sun.color.x), mul8(r, gradientWeight));
+        g = fmadd8(sunShare, set8(sky.sun.color.y), mul8(g, gradientWeight));
+        b = fmadd8(sunShare, set8(sky.sun.color.z), mul8(b, gradientWeight));
+
+        store8(colors[0], mul8(r, load8(misses.throughput[0] + i)));
+        store8(colors[1], mul8(g, load8(misses.throughput[1] + i)));
+        store8(colors[2], mul8(b, load8(misses.throughput[2] + i)));
+
+        const uint32_t count = std::min<uint32_t>(8, misses.count - i);
+
+        for (uint32_t j = 0; j < count; j++) radiance[misses.pixel[i + j]] += vec3(colors[0][j], colors[1][j], colors[2][j]);
+    }
+}
+
+void Pathtrace(PixelSample* pixels,
+               const Ocean& ocean,
+               const Sky& sky,
+               const BlueNoise* blueNoise,
+               const uint64_t& sample,
+               const Tile& tile,
+               const Camera& cam,
+               const Settings& settings) noexcept
+{
+    PathQueue queues[2];
+    PathQueue misses;
+
+    vec3 radiance[maxTilePaths];
+
+    PathQueue* current = &queues[0];
+
+    for (uint32_t y = tile.y_start; y < tile.y_end; y++)
+    {
+        for (uint32_t x = tile.x_start; x < tile.x_end; x++)
+        {
+            const uint16_t index = (x - tile.x_start) + (y - tile.y_start) * tile.size_x;
+
+            RayHit rayhit;
+            SetPrimaryRay(rayhit, cam, x, y, settings.xres, settings.yres, blueNoise, sample);
+
+            PixelSample& pixel = pixels[index];
+            pixel.position = cam.pos + rayhit.ray.direction * skyDistance;
+            pixel.normal = vec3(maths::constants::zero);
+            pixel.depth = maths::constants::inf;
+
+            radiance[index] = vec3(maths::constants::zero);
+
+            PushPath(*current, rayhit.ray.origin, rayhit.ray.direction, vec3(1.0f), 0.0f, 0.0f, index);
+        }
+    }
+
+    for (uint32_t bounce = 0; current->count > 0; bounce++)
+    {
+        PathQueue& next = queues[(bounce + 1) & 1];
+        next.count = 0;
+        misses.count = 0;
+
+        // The last rays only see the sky
+        const bool canBounce = bounce < settings.bounces;
+
+        for (uint32_t i = 0; i < current->count; i++)
+        {
+            const vec3 origin(current->origin[0][i], current->origin[1][i], current->origin[2][i]);
+            const vec3 direction(current->direction[0][i], current->direction[1][i], current->direction[2][i]);
+            const vec3 throughput(current->throughput[0][i], current->throughput[1][i], current->throughput[2][i]);
+            const float lobePdf = current->lobePdf[i];
+            const float envPdf = current->envPdf[i];
+            const uint16_t index = current->pixel[i];
+
+            RayHit rayhit;
+            SetRay(rayhit, origin, direction, 10000.0f);
+
+            bool hit = false;
+
+            if (canBounce && bounce == 0)
+            {
+                hit = Intersect(ocean, rayhit) && Raymarch(ocean, rayhit, settings.time, settings.raymarchOctaves, settings.maxMarchSteps);
+            }
+            else if (canBounce)
+            {
+                // The marcher steps by the height above the waves, only the rays going down can meet them again
+                rayhit.hit.pos = origin;
+                hit = direction.y < 0.0f && Raymarch(ocean, rayhit, settings.time, settings.raymarchOctaves, settings.maxMarchSteps);
+            }
+
+            if (!hit)
+            {
+                PushPath(misses, origin, direction, throughput, lobePdf, envPdf, index);
+                continue;
+            }
+
+            const vec3 position = rayhit.hit.pos;
+
+            vec3 normal = WaveNormal(ocean, vec2(position.x, position.z), settings.time, settings.normalOctaves);
+            if (normal.y < 0.0f) normal = -normal;
+
+            if (bounce == 0)
+            {
+                PixelSample& pixel = pixels[index];
+                pixel.position = position;
+                pixel.normal = normal;
+                pixel.depth = dist(origin, position);
+            }
+
+            const uint32_t x = tile.x_start + index % tile.size_x;
+            const uint32_t y = tile.y_start + index / tile.size_x;
+
+            const float cosI = maths::max(1e-4f, -dot(direction, normal));
+            const float fresnel = FresnelDielectric(cosI, 1.0f / ocean.ior);
+
+            vec3 nextDirection;
+            vec3 nextThroughput = throughput;
+            float nextLobePdf = 0.0f;
+            float nextEnvPdf = 0.0f;
+
+            // Picking the lobe with the Fresnel probability leaves the specular throughput unchanged
+            if (SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_Lobe) < fresnel)
+            {
+                nextDirection = reflect(direction, normal);
+            }
+            else
+            {
+                nextDirection = SampleHemisphere(normal,
+                                                 SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_DirectionU),
+                                                 SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_DirectionV));
+                nextThroughput *= ocean.albedo;
+                nextLobePdf = maths::max(0.0f, dot(nextDirection, normal)) * maths::constants::one_over_pi;
+
+                const bool useEnvMap = HasEnvMapSampler(sky);
+
+                if (useEnvMap) nextEnvPdf = EnvMapPdf(*sky.envMap, nextDirection);
+
+                // Next event estimation of the sun. Occluded when below the horizon, the rays going up are
+                // not marched against the waves
+                float sunPdf;
+                const vec3 sunDirection = SampleSunDirection(sky.sun,
+                                                             SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_SunU),
+                                                             SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_SunV),
+                                                             sunPdf);
+
+                const float cosSun = dot(sunDirection, normal);
+
+                if (cosSun > 0.0f && sunDirection.y > 0.0f && sunPdf > 0.0f)
+                {
+                    const float diffusePdf = cosSun * maths::constants::one_over_pi;
+
+                    const float otherEnvPdf = useEnvMap ? EnvMapPdf(*sky.envMap, sunDirection) : 0.0f;
+
+                    radiance[index] += nextThroughput * SampleSun(sunDirection, sky.sun) * (diffusePdf / sunPdf * PowerHeuristic(sunPdf, diffusePdf, otherEnvPdf));
+                }
+
+                // And of the whole sky through the env map, its gradient is not covered by the sun sampling
+                if (useEnvMap)
+                {
+                    float envPdf;
+                    const vec3 envDirection = SampleEnvMapDirection(*sky.envMap,
+                                                                    SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_EnvU),
+                                                                    SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_EnvV),
+                                                                    envPdf);
+
+                    const float cosEnv = dot(envDirection, normal);
+
+                    if (cosEnv > 0.0f && envDirection.y > 0.0f && envPdf > 0.0f)
+                    {
+                        const float diffusePdf = cosEnv * maths::constants::one_over_pi;
+
+                        const vec3 light = SampleSun(envDirection, sky.sun) * PowerHeuristic(envPdf, diffusePdf, SunPdf(envDirection, sky.sun)) +
+                                           SampleSkyGradient(envDirection, sky) * PowerHeuristic(envPdf, diffusePdf);
+
+                        radiance[index] += nextThroughput * light * (diffusePdf / envPdf);
+                    }
+                }
+            }
+
+            if (bounce >= rouletteFirstBounce)
+            {
+                const float survival = maths::min(1.0f, maths::max(nextThroughput.x, maths::max(nextThroughput.y, nextThroughput.z)));
+
+                if (SamplePathDimension(blueNoise, x, y, sample, bounce, PathDimension_Roulette) >= survival) continue;
+
+                nextThroughput /= survival;
+            }
+
+            PushPath(next, position + normal * surfaceOffset, nextDirection, nextThroughput, nextLobePdf, nextEnvPdf, index);
+        }
+
+        ShadeMisses(misses, sky, radiance);
+
+        current = &next;
+    }
+
+    for (uint32_t i = 0, count = tile.size_x * tile.size_y; i < count; i++)
+    {
+        const vec3& output = radiance[i];
+
+        pixels[i].color = vec3(std::isnan(output.x) ? 0.5f : output.x,
+                               std::isnan(output.y) ? 0.5f : output.y,
+                               std::isnan(output.z) ? 0.5f : output.z);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "render.h"
+
+// Path traced shading of the ocean, used instead of the single sky reflection when the settings ask for bounces.
+// The surface is a dielectric: at each hit the path either reflects with the Fresnel probability, or refracts
+// into the water where the light scattered back up by the water body is modelled as a diffuse lobe of the ocean
+// albedo. Rays going back down can hit the waves again, and long paths are cut by russian roulette.
+//
+// The sun is a very small and very bright lobe, which the diffuse bounces would only find by chance. Each
+// diffuse hit also samples it explicitly, and both strategies are weighted by the power heuristic so the
+// glints lit through the water body converge in a few samples instead of showing up as fireflies. When the sky
+// has an env map sampler, the whole sky is sampled from it as well and the three strategies share the weights.
+//
+// The paths of a tile are not traced one after the other but bounce by bounce through queues. Each bounce
+// marches all the live paths, the ones escaping to the sky are shaded 8 at a time and the others are compacted
+// into the queue of the next bounce. The cost of a bounce follows the number of paths still alive, which drops
+// quickly as most of them leave the ocean after the first reflection
+
+static constexpr uint32_t maxTilePaths = 256; // One per pixel of a 16x16 tile
+
+// Path traced bounces start sampling after the primary ray jitter
+static constexpr uint32_t pathFirstDimension = 2;
+
+enum PathDimension : uint32_t
+{
+    PathDimension_Lobe = 0,
+    PathDimension_DirectionU = 1,
+    PathDimension_DirectionV = 2,
+    PathDimension_Roulette = 3,
+    PathDimension_SunU = 4,
+    PathDimension_SunV = 5,
+    PathDimension_EnvU = 6,
+    PathDimension_EnvV = 7,
+    PathDimension_Count = 8
+};
+
+// Russian roulette only starts once the path has had the chance to pick up the direct reflections
+static constexpr uint32_t rouletteFirstBounce = 2;
+
+// Each bounce of each decision gets its own blue noise dimension, so they stay decorrelated. The tables only
+// hold 8 bits per sample, a hashed offset within the 1/256 stratum fills in the rest so the alias tables can
+// reach all of their slots
+FORCEINLINE float SamplePathDimension(const BlueNoise* blueNoise,
+                                      const uint32_t x,
+                                      const uint32_t y,
+                                      const uint64_t sample,
+                                      const uint32_t bounce,
+                                      const PathDimension dimension) noexcept
+{
+    const uint32_t sampleDimension = pathFirstDimension + bounce * PathDimension_Count + dimension;
+
+    const float stratum = BlueNoiseSamplerSpp(blueNoise, x, y, sample, sampleDimension);
+    const float offset = PcgSampler(x * 73856093u ^ y * 19349663u ^ static_cast<uint32_t>(sample) * 83492791u ^ sampleDimension * 2654435761u);
+
+    return std::min(stratum + (offset - 0.5f) / 256.0f, 0.99999994f);
+}
+
+// Unpolarized reflectance of a dielectric interface, eta is the ratio of the indices of refraction n1 / n2
+FORCEINLINE float FresnelDielectric(const float cosI, const float eta) noexcept
+{
+    const float sin2T = eta * eta * (1.0f - cosI * cosI);
+
+    // Total internal reflection
+    if (sin2T >= 1.0f) return 1.0f;
+
+    const float cosT = maths::sqrt(1.0f - sin2T);
+
+    const float rs = (eta * cosI - cosT) / (eta * cosI + cosT);
+    const float rp = (cosI - eta * cosT) / (cosI + eta * cosT);
+
+    return 0.5f * (rs * rs + rp * rp);
+}
+
+// Multiple importance sampling weight of a strategy against up to two others, all taking a single sample
+FORCEINLINE float PowerHeuristic(const float pdf, const float otherPdf, const float secondOtherPdf = 0.0f) noexcept
+{
+    return pdf * pdf / (pdf * pdf + otherPdf * otherPdf + secondOtherPdf * secondOtherPdf);
+}
+
+// Traces one sample for every pixel of the tile, pixels are stored row after row from the tile origin
+void Pathtrace(PixelSample* pixels,
+               const Ocean& ocean,
+               const Sky& sky,
+               const BlueNoise* blueNoise,
+               const uint64_t& sample,
+               const Tile& tile,
+               const Camera& cam,
+               const Settings& settings) noexcept;
@@ -0,0 +1,30 @@
+#include "preview.h"
+
+void UpdatePreview(Preview& preview, const bool moving) noexcept
+{
+    if (!preview.settings.enabled)
+    {
+        preview.level = preview.settings.refineFrames;
+        return;
+    }
+
+    if (moving) preview.level = 0;
+    else if (preview.level < preview.settings.refineFrames) preview.level++;
+}
+
+void ApplyPreview(const Preview& preview, Settings& settings) noexcept
+{
+    if (!IsPreviewing(preview)) return;
+
+    const float t = static_cast<float>(preview.level) / static_cast<float>(preview.settings.refineFrames);
+
+    const float resolutionScale = maths::lerp(preview.settings.resolutionScale, 1.0f, t);
+    const float raymarchOctaves = maths::round(maths::lerp(preview.settings.raymarchOctaves, settings.raymarchOctaves, t));
+    const float normalOctaves = maths::round(maths::lerp(preview.settings.normalOctaves, settings.normalOctaves, t));
+    const float maxMarchSteps = maths::round(maths::lerp(preview.settings.maxMarchSteps, settings.maxMarchSteps, t));
+
+    settings.resolutionScale = maths::min(settings.resolutionScale, resolutionScale);
+    settings.raymarchOctaves = maths::min(settings.raymarchOctaves, raymarchOctaves);
+    settings.normalOctaves = maths::min(settings.normalOctaves, normalOctaves);
+    settings.maxMarchSteps = maths::min(settings.maxMarchSteps, maxMarchSteps);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "settings.h"
+
+// Motion adaptive preview. While the camera moves we render a cheap low resolution and low octaves
+// version of the frame, then once it stops we refine back to full quality over a few frames
+
+struct PreviewSettings
+{
+    bool enabled = true;
+
+    float resolutionScale = 0.25f;
+    uint8_t raymarchOctaves = 4;
+    uint8_t normalOctaves = 8;
+    uint16_t maxMarchSteps = 60;
+
+    uint8_t refineFrames = 4; // Frames to go from the preview back to full quality
+};
+
+struct Preview
+{
+    PreviewSettings settings;
+
+    uint8_t level = 0; // 0 is the cheapest preview, refineFrames is full quality
+};
+
+void UpdatePreview(Preview& preview, const bool moving) noexcept;
+
+FORCEINLINE bool IsPreviewing(const Preview& preview) noexcept
+{
+    return preview.settings.enabled && preview.level < preview.settings.refineFrames;
+}
+
+// Lowers the settings knobs to the current preview level, never raises them
+void ApplyPreview(const Preview& preview, Settings& settings) noexcept;
@@ -3,6 +3,7 @@
 #include "maths.h"
 #include "camera.h"
 #include "sampling.h"
+#include "raycache.h"
 
 #include <limits>
 #include <stdint.h>
@@ -39,15 +40,35 @@ FORCEINLINE void SetRay(RayHit& rayhit, const vec3& position, const vec3& direct
 	rayhit.ray.t = t;
 }
 
+// Unjittered primary ray direction through the continuous pixel coordinates px, py
+FORCEINLINE vec3 PrimaryDirection(const Camera& cam,
+								  const float px,
+								  const float py,
+								  const uint32_t xres,
+								  const uint32_t yres) noexcept
+{
+	const float xScreen = (2.0f * px / float(xres) - 1.0f) * cam.aspect * cam.scale;
+	const float yScreen = (1.0f - 2.0f * py / float(yres)) * cam.scale;
+
+	return normalize(transform_dir(vec3(xScreen, yScreen, -1.0f), cam.transformation_matrix));
+}
+
 FORCEINLINE void SetPrimaryRay(RayHit& rayhit,
 	   							 const Camera& cam,
 	   							 const uint32_t x,
 	   							 const uint32_t y,
 	   							 const uint32_t xres,
 	   							 const uint32_t yres,
-								 const uint32_t* blueNoise,
+								 const BlueNoise* blueNoise,
 	   							 const uint64_t sample) noexcept
 {
+	// Only the origin changes when the camera translates
+	if (IsRayCacheValid(cam, xres, yres, blueNoise, sample))
+	{
+		SetRay(rayhit, cam.pos, GetCachedDirection(*cam.rayCache, x, y), 10000.0f);
+		return;
+	}
+
 	// Generate xyz screen to normalized world coordinates
 
 	// Very simple antialiasing
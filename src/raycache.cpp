@@ -0,0 +1,74 @@
+#include "raycache.h"
+
+#include "tbb/parallel_for.h"
+
+#include <algorithm>
+
+bool UpdateRayCache(RayCache& cache,
+                    const Camera& cam,
+                    const uint16_t xres,
+                    const uint16_t yres,
+                    const BlueNoise* blueNoise,
+                    const uint64_t sample) noexcept
+{
+    if (cache.valid &&
+        cache.xres == xres &&
+        cache.yres == yres &&
+        cache.sample == sample &&
+        cache.blueNoise == blueNoise &&
+        IsRayCacheOf(cache, cam)) return false;
+
+    if (cache.xres != xres || cache.yres != yres || cache.directions[0] == nullptr)
+    {
+        ReleaseRayCache(cache);
+
+        cache.xres = xres;
+        cache.yres = yres;
+        cache.stride = (xres + 7) & ~7u;
+
+        for (uint32_t i = 0; i < 3; i++) cache.directions[i] = new float[cache.stride * yres];
+    }
+
+    for (uint32_t i = 0; i < 9; i++) cache.rotation[i] = cam.transformation_matrix[i / 3][i % 3];
+
+    cache.scale = cam.scale;
+    cache.aspect = cam.aspect;
+    cache.sample = sample;
+    cache.blueNoise = blueNoise;
+
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, yres), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (uint32_t x = 0; x < xres; x += 8)
+                {
+                    vfloat8 dx, dy, dz;
+                    PrimaryDirections8(cam, x, y, xres, yres, blueNoise, sample, std::min<uint32_t>(8, xres - x), dx, dy, dz);
+
+                    const uint32_t index = x + y * cache.stride;
+
+                    storeu8(cache.directions[0] + index, dx);
+                    storeu8(cache.directions[1] + index, dy);
+                    storeu8(cache.directions[2] + index, dz);
+                }
+            }
+        });
+
+    cache.valid = true;
+
+    return true;
+}
+
+void ReleaseRayCache(RayCache& cache) noexcept
+{
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        delete[] cache.directions[i];
+        cache.directions[i] = nullptr;
+    }
+
+    cache.xres = 0;
+    cache.yres = 0;
+    cache.stride = 0;
+    cache.valid = false;
+}
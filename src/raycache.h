@@ -0,0 +1,108 @@
+#pragma once
+
+#include "camera.h"
+#include "sampling.h"
+#include "simd.h"
+
+// Table of the jittered primary ray directions of a frame. The directions only depend on the camera rotation,
+// field of view, resolution and jitter, so the table survives camera translations and the tiles read it
+// instead of generating rays
+
+struct RayCache
+{
+    float* directions[3] = { nullptr, nullptr, nullptr }; // SoA, rows padded to a multiple of 8
+
+    uint32_t stride = 0;
+    uint16_t xres = 0;
+    uint16_t yres = 0;
+
+    // What the table has been generated with
+    float rotation[9];
+    float scale = 0.0f;
+    float aspect = 0.0f;
+    uint64_t sample = 0;
+    const BlueNoise* blueNoise = nullptr;
+
+    bool valid = false;
+};
+
+// Jittered primary directions of up to 8 consecutive pixels of a row, same projection as SetPrimaryRay
+FORCEINLINE void PrimaryDirections8(const Camera& cam,
+                                    const uint32_t x,
+                                    const uint32_t y,
+                                    const uint32_t xres,
+                                    const uint32_t yres,
+                                    const BlueNoise* blueNoise,
+                                    const uint64_t sample,
+                                    const uint32_t count,
+                                    vfloat8& dx,
+                                    vfloat8& dy,
+                                    vfloat8& dz) noexcept
+{
+    alignas(32) float jitterX[8] = { 0.0f };
+    alignas(32) float jitterY[8] = { 0.0f };
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        jitterX[i] = BlueNoiseSamplerSpp(blueNoise, x + i, y, sample, 0);
+        jitterY[i] = BlueNoiseSamplerSpp(blueNoise, x + i, y, sample, 1);
+    }
+
+    const vfloat8 px = add8(add8(set8(static_cast<float>(x)), iota8()), load8(jitterX));
+    const vfloat8 py = add8(set8(static_cast<float>(y)), load8(jitterY));
+
+    const vfloat8 xScreen = mul8(fmadd8(px, set8(2.0f / xres), set8(-1.0f)), set8(cam.aspect * cam.scale));
+    const vfloat8 yScreen = mul8(fmadd8(py, set8(-2.0f / yres), set8(1.0f)), set8(cam.scale));
+
+    const mat44& m = cam.transformation_matrix;
+
+    dx = sub8(fmadd8(xScreen, set8(m[0][0]), mul8(yScreen, set8(m[0][1]))), set8(m[0][2]));
+    dy = sub8(fmadd8(xScreen, set8(m[1][0]), mul8(yScreen, set8(m[1][1]))), set8(m[1][2]));
+    dz = sub8(fmadd8(xScreen, set8(m[2][0]), mul8(yScreen, set8(m[2][1]))), set8(m[2][2]));
+
+    const vfloat8 invLength = div8(set8(1.0f), sqrt8(fmadd8(dx, dx, fmadd8(dy, dy, mul8(dz, dz)))));
+
+    dx = mul8(dx, invLength);
+    dy = mul8(dy, invLength);
+    dz = mul8(dz, invLength);
+}
+
+// Regenerates the table if the rotation, field of view, resolution or jitter changed, returns true if it did
+bool UpdateRayCache(RayCache& cache,
+                    const Camera& cam,
+                    const uint16_t xres,
+                    const uint16_t yres,
+                    const BlueNoise* blueNoise,
+                    const uint64_t sample) noexcept;
+
+void ReleaseRayCache(RayCache& cache) noexcept;
+
+FORCEINLINE bool IsRayCacheOf(const RayCache& cache, const Camera& cam) noexcept
+{
+    for (uint32_t i = 0; i < 9; i++)
+    {
+        if (cache.rotation[i] != cam.transformation_matrix[i / 3][i % 3]) return false;
+    }
+
+    return cache.scale == cam.scale && cache.aspect == cam.aspect;
+}
+
+// The camera can carry a cache built for another pose, when it has been copied and then rotated for example
+FORCEINLINE bool IsRayCacheValid(const Camera& cam,
+                                 const uint32_t xres,
+                                 const uint32_t yres,
+                                 const BlueNoise* blueNoise,
+                                 const uint64_t sample) noexcept
+{
+    const RayCache* cache = cam.rayCache;
+
+    return cache != nullptr && cache->valid && cache->xres == xres && cache->yres == yres && 
+           cache->blueNoise == blueNoise && cache->sample == sample && IsRayCacheOf(*cache, cam);
+}
+
+FORCEINLINE vec3 GetCachedDirection(const RayCache& cache, const uint32_t x, const uint32_t y) noexcept
+{
+    const uint32_t index = x + y * cache.stride;
+
+    return vec3(cache.directions[0][index], cache.directions[1][index], cache.directions[2][index]);
+}
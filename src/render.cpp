@@ -1,15 +1,16 @@
 #include "render.h"
+#include "pathtrace.h"
 
 void GenerateTiles(Tiles& tiles, 
                    const Settings& settings) noexcept
 {   
     constexpr uint8_t tilesize = 16;
 
-    const uint16_t tileCountX = maths::ceil(settings.xres / tilesize);
-    const uint16_t tileCountY = maths::ceil(settings.yres / tilesize);
+    const uint16_t tileCountX = (settings.xres + tilesize - 1) / tilesize;
+    const uint16_t tileCountY = (settings.yres + tilesize - 1) / tilesize;
 
-    const uint8_t lastTileSizeX = maths::ceil(maths::fmod(settings.xres, tilesize)) == 0 ? 32 : maths::ceil(maths::fmod(settings.xres, tilesize));
-    const uint8_t lastTileSizeY = maths::ceil(maths::fmod(settings.yres, tilesize)) == 0 ? 32 : maths::ceil(maths::fmod(settings.yres, tilesize));
+    const uint8_t lastTileSizeX = settings.xres % tilesize == 0 ? tilesize : settings.xres % tilesize;
+    const uint8_t lastTileSizeY = settings.yres % tilesize == 0 ? tilesize : settings.yres % tilesize;
 
     tiles.count = tileCountX * tileCountY;
 
@@ -37,14 +38,33 @@ void GenerateTiles(Tiles& tiles,
                 tmpTile.size_y = lastTileSizeY;
             }
 
-            tmpTile.pixels = new color[tmpTile.size_x * tmpTile.size_y];
-            tmpTile.randoms = new float[tmpTile.size_x * tmpTile.size_y * 2];
-
             tiles.tiles.push_back(tmpTile);
 
             idx++;
         }
     }
+
+    const auto allocateBuffers = [&](Tile& tile)
+        {
+            if (settings.progressive) tile.pixels = new color[tile.size_x * tile.size_y]();
+            tile.randoms = new float[tile.size_x * tile.size_y * 2];
+        };
+
+    if (IsNumaEnabled(tiles.numa))
+    {
+        // First touched by the node rendering them
+        RunOnNumaNodes(*tiles.numa, [&](const uint32_t node)
+            {
+                for (Tile& tile : tiles.tiles)
+                {
+                    if (GetNumaRowNode(*tiles.numa, tile.y_start, settings.yres) == node) allocateBuffers(tile);
+                }
+            });
+    }
+    else
+    {
+        for (Tile& tile : tiles.tiles) allocateBuffers(tile);
+    }
 }
 
 void ReleaseTiles(Tiles& tiles) noexcept
@@ -57,57 +77,308 @@ void ReleaseTiles(Tiles& tiles) noexcept
         delete[] tile.randoms;
         tile.randoms = nullptr;
     }
+
+    tiles.tiles.clear();
+    tiles.count = 0;
+}
+
+void AllocateAOVs(AOVs& aovs, const uint16_t xres, const uint16_t yres) noexcept
+{
+    ReleaseAOVs(aovs);
+
+    aovs.xres = xres;
+    aovs.yres = yres;
+
+    // Cleared, a render region leaves the pixels outside of it untouched
+    aovs.beauty = new color[xres * yres]();
+    aovs.position = new vec3[xres * yres]();
+    aovs.normal = new vec3[xres * yres]();
+    aovs.depth = new float[xres * yres]();
+}
+
+void ReleaseAOVs(AOVs& aovs) noexcept
+{
+    delete[] aovs.beauty;
+    aovs.beauty = nullptr;
+
+    delete[] aovs.position;
+    aovs.position = nullptr;
+
+    delete[] aovs.normal;
+    aovs.normal = nullptr;
+
+    delete[] aovs.depth;
+    aovs.depth = nullptr;
 }
 
 void SetTilePixel(Tile& tile, const vec3& color, uint32_t x, uint32_t y) noexcept
 {
-    tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].R = color.x;
-    tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].G = color.y;
-    tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].B = color.z;
+    tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_x].R = color.x;
+    tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_x].G = color.y;
+    tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_x].B = color.z;
+}
+
+// Writes a finished pixel to the output. With aovs the linear color and hit data go to the planes for a
+// later resolve. In progressive mode the sample is first accumulated in the tile scratch buffer, 
+// otherwise it goes straight to the framebuffer
+
+FORCEINLINE void OutputPixel(FrameBuffer& buffer, 
+                             AOVs* aovs,
+                             const Tile& tile, 
+                             const PixelSample& sample, 
+                             const uint32_t x, 
+                             const uint32_t y, 
+                             const uint64_t sampleIndex, 
+                             const Settings& settings) noexcept
+{
+    constexpr float gamma = 1.0f / 2.2f;
+
+    const vec3& output = sample.color;
+
+    if (aovs != nullptr)
+    {
+        const uint32_t index = x + y * settings.xres;
+
+        if (aovs->position != nullptr) aovs->position[index] = sample.position;
+        if (aovs->normal != nullptr) aovs->normal[index] = sample.normal;
+        if (aovs->depth != nullptr) aovs->depth[index] = sample.depth;
+
+        if (aovs->beauty != nullptr)
+        {
+            aovs->beauty[index] = { output.x, output.y, output.z };
+            return;
+        }
+    }
+
+    vec3 result = output;
+
+    if (tile.pixels != nullptr)
+    {
+        color& pixel = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_x];
+
+        const float weight = 1.0f / static_cast<float>(sampleIndex);
+
+        pixel.R = maths::lerp(pixel.R, output.x, weight);
+        pixel.G = maths::lerp(pixel.G, output.y, weight);
+        pixel.B = maths::lerp(pixel.B, output.z, weight);
+
+        result = vec3(pixel.R, pixel.G, pixel.B);
+    }
+
+    SetFrameBufferPixel(buffer, x + y * settings.xres, powvec3(result, gamma));
+}
+
+// Up to 8 consecutive sky pixels of a row, the primary directions and the sky are evaluated 8 wide
+FORCEINLINE void RenderSkySpan(FrameBuffer& buffer,
+                               AOVs* aovs,
+                               const Tile& tile,
+                               const Sky& sky,
+                               const BlueNoise* blueNoise,
+                               const uint64_t& sample,
+                               const Camera& cam,
+                               const Settings& settings,
+                               const uint32_t x,
+                               const uint32_t y,
+                               const uint32_t count) noexcept
+{
+    vfloat8 dx, dy, dz;
+
+    if (IsRayCacheValid(cam, settings.xres, settings.yres, blueNoise, sample))
+    {
+        const uint32_t index = x + y * cam.rayCache->stride;
+
+        dx = loadu8(cam.rayCache->directions[0] + index);
+        dy = loadu8(cam.rayCache->directions[1] + index);
+        dz = loadu8(cam.rayCache->directions[2] + index);
+    }
+    else
+    {
+        PrimaryDirections8(cam, x, y, settings.xres, settings.yres, blueNoise, sample, count, dx, dy, dz);
+    }
+
+    vfloat8 r, g, b;
+    SampleSky8(dx, dy, dz, sky, r, g, b);
+
+    alignas(32) float directions[3][8];
+    alignas(32) float colors[3][8];
+
+    store8(directions[0], dx);
+    store8(directions[1], dy);
+    store8(directions[2], dz);
+    store8(colors[0], r);
+    store8(colors[1], g);
+    store8(colors[2], b);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        PixelSample pixel;
+        pixel.color = vec3(colors[0][i], colors[1][i], colors[2][i]);
+        pixel.position = cam.pos + vec3(directions[0][i], directions[1][i], directions[2][i]) * skyDistance;
+
+        OutputPixel(buffer, aovs, tile, pixel, x + i, y, sample, settings);
+    }
+}
+
+void TracePixel(PixelSample& pixel,
+                const Ocean& ocean,
+                const Sky& sky,
+                const BlueNoise* blueNoise,
+                const uint64_t& sample,
+                const Camera& cam,
+                const Settings& settings,
+                const uint32_t x,
+                const uint32_t y) noexcept
+{
+    vec3 output = vec3(maths::constants::zero);
+
+    RayHit tmpRayHit;
+
+    SetPrimaryRay(tmpRayHit, cam, x, y, settings.xres, settings.yres, blueNoise, sample);
+
+    pixel.position = cam.pos + tmpRayHit.ray.direction * skyDistance;
+    pixel.normal = vec3(maths::constants::zero);
+    pixel.depth = maths::constants::inf;
+    
+    if(Intersect(ocean, tmpRayHit))
+    {
+        if(Raymarch(ocean, tmpRayHit, settings.time, settings.raymarchOctaves, settings.maxMarchSteps))
+        {
+            const vec3 hitNormal = WaveNormal(ocean, vec2(tmpRayHit.hit.pos.x, tmpRayHit.hit.pos.z), settings.time, settings.normalOctaves);
+            const vec3 r = reflect(tmpRayHit.ray.direction, hitNormal);
+
+            pixel.position = tmpRayHit.hit.pos;
+            pixel.normal = hitNormal;
+            pixel.depth = dist(tmpRayHit.ray.origin, pixel.position);
+
+            // output = lerp(vec3(0.0f, 1.0f, 0.0f), hitNormal, 1.0f / (tmpRayHit.ray.t * 0.01f + 1.0f));
+            output = SampleSkyReflection(r, sky, pixel.depth);
+        }
+        else
+        {
+            output = SampleSky(tmpRayHit.ray.direction, sky);
+        }
+    }
+    else
+    {
+        output = SampleSky(tmpRayHit.ray.direction, sky);
+    }
+
+    pixel.color = vec3(std::isnan(output.x) ? 0.5f : output.x, 
+                       std::isnan(output.y) ? 0.5f : output.y, 
+                       std::isnan(output.z) ? 0.5f : output.z);
+}
+
+void ResolveAOVs(FrameBuffer& buffer, const AOVs& aovs, const RenderRegion& region) noexcept
+{
+    constexpr float gamma = 1.0f / 2.2f;
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(region.y_start, region.y_end), [&](const tbb::blocked_range<size_t>& r)
+        {
+            for (size_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (size_t x = region.x_start; x < region.x_end; x++)
+                {
+                    const color& pixel = aovs.beauty[x + y * aovs.xres];
+
+                    SetFrameBufferPixel(buffer, x + y * aovs.xres, powvec3(vec3(pixel.R, pixel.G, pixel.B), gamma));
+                }
+            }
+        });
 }
 
-void Render(color* __restrict buffer,
+void Render(FrameBuffer& buffer,
             const Ocean& ocean,
             const Sky& sky,
-            const uint32_t* blueNoise,
+            const BlueNoise* blueNoise,
             const uint64_t& seed,
             const uint64_t& sample,
             const Tiles& tiles, 
             const Camera& cam, 
-            const Settings& settings) noexcept
+            const Settings& settings,
+            AOVs* aovs) noexcept
 {
-    static tbb::affinity_partitioner partitioner;
+    RenderView view;
+    view.buffer = &buffer;
+    view.tiles = &tiles;
+    view.cam = cam;
+    view.aovs = aovs;
 
-    constexpr float gamma = 1.0f / 2.2f;
+    RenderViews(&view, 1, ocean, sky, blueNoise, seed, sample, settings);
+}
+
+void RenderViews(const RenderView* views,
+                 const uint32_t viewCount,
+                 const Ocean& ocean,
+                 const Sky& sky,
+                 const BlueNoise* blueNoise,
+                 const uint64_t& seed,
+                 const uint64_t& sample,
+                 const Settings& settings) noexcept
+{
+    WaveTable waves;
+    const Ocean frameOcean = PrepareFrameOcean(ocean, waves, settings);
+
+    struct ViewTile
+    {
+        const RenderView* view;
+        const Tile* tile;
+    };
 
-    tbb::parallel_for(tbb::blocked_range<size_t>(0, tiles.count), [&](const tbb::blocked_range<size_t>& r)
+    // Only the tiles overlapping the region are scheduled
+    std::vector<ViewTile> viewTiles;
+
+    for (uint32_t v = 0; v < viewCount; v++)
+    {
+        for (const Tile& tile : views[v].tiles->tiles)
         {
-            for (size_t t = r.begin(), t_end = r.end(); t < t_end; t++)
-            {
-                RenderTile(ocean, sky, blueNoise, seed, sample, tiles.tiles[t], cam, settings);
+            if (IsTileInRegion(tile, settings)) viewTiles.push_back({ &views[v], &tile });
+        }
+    }
 
-                for (int y = 0; y < tiles.tiles[t].size_y; y++)
+    const auto renderTiles = [&](const std::vector<ViewTile>& list, auto&& partitioner)
+        {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, list.size()), [&](const tbb::blocked_range<size_t>& r)
                 {
-                    for (int x = 0; x < tiles.tiles[t].size_x; x++)
+                    for (size_t t = r.begin(), t_end = r.end(); t < t_end; t++)
                     {
-                        buffer[tiles.tiles[t].x_start + x + (tiles.tiles[t].y_start + y) * settings.xres].R = maths::pow(tiles.tiles[t].pixels[x + y * tiles.tiles[t].size_x].R, gamma);
-                        buffer[tiles.tiles[t].x_start + x + (tiles.tiles[t].y_start + y) * settings.xres].G = maths::pow(tiles.tiles[t].pixels[x + y * tiles.tiles[t].size_x].G, gamma);
-                        buffer[tiles.tiles[t].x_start + x + (tiles.tiles[t].y_start + y) * settings.xres].B = maths::pow(tiles.tiles[t].pixels[x + y * tiles.tiles[t].size_x].B, gamma);
+                        const RenderView& view = *list[t].view;
+
+                        RenderTile(*view.buffer, frameOcean, sky, blueNoise, seed, sample, *list[t].tile, view.cam, settings, view.aovs);
                     }
-                }
-            }
 
-        }, partitioner);
+                }, partitioner);
+        };
+
+    NumaTopology* numa = views[0].tiles->numa;
+
+    if (IsNumaEnabled(numa))
+    {
+        // Each node renders the tiles of its own band of rows, in its own arena
+        std::vector<std::vector<ViewTile>> nodeTiles(GetNumaNodeCount(*numa));
+
+        for (const ViewTile& viewTile : viewTiles)
+        {
+            nodeTiles[GetNumaRowNode(*numa, viewTile.tile->y_start, settings.yres)].push_back(viewTile);
+        }
+
+        RunOnNumaNodes(*numa, [&](const uint32_t node) { renderTiles(nodeTiles[node], tbb::auto_partitioner()); });
+
+        return;
+    }
+
+    renderTiles(viewTiles, views[0].tiles->partitioner);
 }
 
-void RenderTile(const Ocean& ocean,
+void RenderTile(FrameBuffer& buffer,
+                const Ocean& ocean,
                 const Sky& sky,
-                const uint32_t* blueNoise,
+                const BlueNoise* blueNoise,
                 const uint64_t& seed,
                 const uint64_t& sample,
                 const Tile& tile,
                 const Camera& cam,
-                const Settings& settings) noexcept
+                const Settings& settings,
+                AOVs* aovs) noexcept
 {
     // Method to see if we intersect something in the tile by tracing a ray at each corner. If we don't, just 
     // sample the background and do another tile
@@ -130,87 +401,42 @@ void RenderTile(const Ocean& ocean,
         }
     }
 
-    if(hasHitSomething)
+    if(hasHitSomething && settings.bounces > 0)
+    {
+        PixelSample pixels[maxTilePaths];
+
+        Pathtrace(pixels, ocean, sky, blueNoise, sample, tile, cam, settings);
+
+        for (uint32_t y = tile.y_start; y < tile.y_end; y++)
+        {
+            for (uint32_t x = tile.x_start; x < tile.x_end; x++)
+            {
+                OutputPixel(buffer, aovs, tile, pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_x], x, y, sample, settings);
+            }
+        }
+    }
+    else if(hasHitSomething)
     {
         for (int y = tile.y_start; y < tile.y_end; y++)
         {
             for (int x = tile.x_start; x < tile.x_end; x++)
             {
-                vec3 output = vec3(maths::constants::zero);
+                PixelSample pixel;
 
-                RayHit tmpRayHit;
+                TracePixel(pixel, ocean, sky, blueNoise, sample, cam, settings, x, y);
 
-                SetPrimaryRay(tmpRayHit, cam, x, y, settings.xres, settings.yres, blueNoise, sample);
-                
-                if(Intersect(ocean, tmpRayHit))
-                {
-                    if(Raymarch(ocean, tmpRayHit, settings.time))
-                    {
-                        const vec3 hitNormal = WaveNormal(ocean, vec2(tmpRayHit.hit.pos.x, tmpRayHit.hit.pos.z), settings.time);
-                        const vec3 r = reflect(tmpRayHit.ray.direction, hitNormal);
-                        // output = lerp(vec3(0.0f, 1.0f, 0.0f), hitNormal, 1.0f / (tmpRayHit.ray.t * 0.01f + 1.0f));
-                        output = SampleSky(r, sky);
-                    }
-                    else
-                    {
-                        output = SampleSky(tmpRayHit.ray.direction, sky);
-                    }
-                }
-                else
-                {
-                    output = SampleSky(tmpRayHit.ray.direction, sky);
-                }
-
-                const vec3 outputCorrected = vec3(std::isnan(output.x) ? 0.5f : output.x, 
-                                                  std::isnan(output.y) ? 0.5f : output.y, 
-                                                  std::isnan(output.z) ? 0.5f : output.z);
-
-                // const float pixelR = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].R;
-                // const float pixelG = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].G;
-                // const float pixelB = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].B;
-
-                // tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].R = maths::lerp(pixelR, outputCorrected.x, 1.0f / static_cast<float>(sample));
-                // tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].G = maths::lerp(pixelG, outputCorrected.y, 1.0f / static_cast<float>(sample));
-                // tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].B = maths::lerp(pixelB, outputCorrected.z, 1.0f / static_cast<float>(sample));
-                
-                tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].R = outputCorrected.x;
-                tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].G = outputCorrected.y;
-                tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].B = outputCorrected.z;
+                OutputPixel(buffer, aovs, tile, pixel, x, y, sample, settings);
             }
         }
     }
     else
     {
-        for (int y = tile.y_start; y < tile.y_end; y++)
+        for (uint32_t y = tile.y_start; y < tile.y_end; y++)
         {
-            for (int x = tile.x_start; x < tile.x_end; x++)
+            for (uint32_t x = tile.x_start; x < tile.x_end; x += 8)
             {
-                RayHit tmpRayHit;
-
-                SetPrimaryRay(tmpRayHit, cam, x, y, settings.xres, settings.yres, blueNoise, sample);
-                
-                const vec3 output = SampleSky(tmpRayHit.ray.direction, sky);
-
-                const float pixelR = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].R;
-                const float pixelG = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].G;
-                const float pixelB = tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].B;
-
-                tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].R = maths::lerp(pixelR, output.x, 1.0f / static_cast<float>(sample));
-                tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].G = maths::lerp(pixelG, output.y, 1.0f / static_cast<float>(sample));
-                tile.pixels[(x - tile.x_start) + (y - tile.y_start) * tile.size_y].B = maths::lerp(pixelB, output.z, 1.0f / static_cast<float>(sample));
+                RenderSkySpan(buffer, aovs, tile, sky, blueNoise, sample, cam, settings, x, y, std::min<uint32_t>(8, tile.x_end - x));
             }
         }
     }
 }
-
-vec3 Pathtrace(const Ocean& ocean,
-               const Sky& sky,
-               const uint32_t* blueNoise,
-               const uint32_t x,
-               const uint32_t y,
-			   const uint32_t sample,
-               const uint32_t seed, 
-               RayHit& rayhit) noexcept
-{
-
-}
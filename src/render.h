@@ -4,21 +4,23 @@
 #include "sampling.h"
 #include "camera.h"
 #include "settings.h"
-#include "GL/glew.h"
 #include "sky.h"
+#include "envmap.h"
 #include "ocean.h"
+#include "framebuffer.h"
+#include "numa.h"
 #include "tbb/tbb.h"
 
 #include <vector>
 #include <iostream>
 
-typedef struct { GLfloat R, G, B; } color;
+typedef struct { float R, G, B; } color;
 
 #undef min, max
 
 struct alignas(32) Tile
 {
-	color* pixels = nullptr;
+	color* pixels = nullptr; // Accumulation scratch, only allocated in progressive mode
 	float* randoms;
 
 	uint16_t x_start, x_end;
@@ -34,8 +36,74 @@ struct Tiles
 	std::vector<Tile> tiles;
 	
 	uint16_t count;
+
+	// Set before generating the tiles, their buffers are then allocated and rendered by the node owning their rows
+	NumaTopology* numa = nullptr;
+
+	// Replays the tile to thread mapping of the previous render. Owned by the tiles so two renders running at the
+	// same time, like the warp hole filling and the render thread, never share one
+	mutable tbb::affinity_partitioner partitioner;
+};
+
+FORCEINLINE bool HasRenderRegion(const Settings& settings) noexcept
+{
+	return settings.region.x_end > settings.region.x_start && settings.region.y_end > settings.region.y_start;
+}
+
+// Pixel rect actually rendered, the region clamped to the frame or the whole frame without one
+FORCEINLINE RenderRegion GetPixelRegion(const Settings& settings) noexcept
+{
+	RenderRegion region;
+	region.x_end = settings.xres;
+	region.y_end = settings.yres;
+
+	if (!HasRenderRegion(settings)) return region;
+
+	region.x_end = std::min(settings.region.x_end, settings.xres);
+	region.y_end = std::min(settings.region.y_end, settings.yres);
+	region.x_start = std::min(settings.region.x_start, region.x_end);
+	region.y_start = std::min(settings.region.y_start, region.y_end);
+
+	return region;
+}
+
+FORCEINLINE bool IsTileInRegion(const Tile& tile, const Settings& settings) noexcept
+{
+	if (!HasRenderRegion(settings)) return true;
+
+	return tile.x_end > settings.region.x_start && tile.x_start < settings.region.x_end &&
+		   tile.y_end > settings.region.y_start && tile.y_start < settings.region.y_end;
+}
+
+// Full frame auxiliary planes, null planes are skipped. When the beauty plane is set the linear color goes
+// there instead of the framebuffer, and a post stage is responsible for the final resolve
+
+static constexpr float skyDistance = 10000.0f;
+
+struct AOVs
+{
+	color* beauty = nullptr;
+	vec3* position = nullptr; // World position of the hit, or a far point along the ray for the sky
+	vec3* normal = nullptr;   // Wave normal, zero for the sky
+	float* depth = nullptr;   // Distance along the primary ray, infinite for the sky
+
+	uint16_t xres = 0;
+	uint16_t yres = 0;
 };
 
+// Everything a primary sample produces
+struct PixelSample
+{
+	vec3 color;
+	vec3 position;
+	vec3 normal;
+	float depth = maths::constants::inf;
+};
+
+void AllocateAOVs(AOVs& aovs, const uint16_t xres, const uint16_t yres) noexcept;
+
+void ReleaseAOVs(AOVs& aovs) noexcept;
+
 void GenerateTiles(Tiles& tiles, 
 				   const Settings& settings) noexcept;
 
@@ -43,30 +111,70 @@ void ReleaseTiles(Tiles& tiles) noexcept;
 
 void SetTilePixel(Tile& tile, const vec3& color, uint32_t x, uint32_t y) noexcept;
 
-void Render(color* __restrict buffer,
+void Render(FrameBuffer& buffer,
 		    const Ocean& ocean,
 			const Sky& sky,
-			const uint32_t* blueNoise,
+			const BlueNoise* blueNoise,
 			const uint64_t& seed, 
 			const uint64_t& sample,
 			const Tiles& tiles, 
 			const Camera& cam, 
-			const Settings& settings) noexcept;
+			const Settings& settings,
+			AOVs* aovs = nullptr) noexcept;
+
+// One camera of a multi view render. All the views share the settings, so the resolution and the time
+struct RenderView
+{
+	FrameBuffer* buffer = nullptr;
+	const Tiles* tiles = nullptr; // Per view when progressive, the accumulation lives in the tiles
+	Camera cam;
+	AOVs* aovs = nullptr;
+};
+
+// Renders several cameras of the same ocean at the same time. The time dependent state is set up once for all
+// of them and the tiles of every view are scheduled in a single parallel pass, so a cheap view does not leave
+// cores idle while an expensive one finishes
+void RenderViews(const RenderView* views,
+				 const uint32_t viewCount,
+				 const Ocean& ocean,
+				 const Sky& sky,
+				 const BlueNoise* blueNoise,
+				 const uint64_t& seed,
+				 const uint64_t& sample,
+				 const Settings& settings) noexcept;
+
+// Time dependent state shared by all the rays of a frame, the sky is baked by the caller through its env map
+FORCEINLINE Ocean PrepareFrameOcean(const Ocean& ocean, WaveTable& waves, const Settings& settings) noexcept
+{
+	BuildWaveTable(waves, ocean, settings.time, std::max(settings.raymarchOctaves, settings.normalOctaves));
+
+	Ocean frameOcean = ocean;
+	frameOcean.waves = &waves;
+
+	return frameOcean;
+}
+
+// Traces the primary ray of a single pixel and shades it
+void TracePixel(PixelSample& pixel,
+				const Ocean& ocean,
+				const Sky& sky,
+				const BlueNoise* blueNoise,
+				const uint64_t& sample,
+				const Camera& cam,
+				const Settings& settings,
+				const uint32_t x,
+				const uint32_t y) noexcept;
+
+// Gamma corrects the beauty plane into the framebuffer, only within the region
+void ResolveAOVs(FrameBuffer& buffer, const AOVs& aovs, const RenderRegion& region) noexcept;
 
-void RenderTile(const Ocean& ocean,
+void RenderTile(FrameBuffer& buffer,
+				const Ocean& ocean,
 				const Sky& sky,
-				const uint32_t* blueNoise,
+				const BlueNoise* blueNoise,
 				const uint64_t& seed,
 				const uint64_t& sample,
 				const Tile& tile,
 				const Camera& cam,
-				const Settings& settings) noexcept;
-
-vec3 Pathtrace(const Ocean& ocean,
-			   const Sky& sky,
-			   const uint32_t* blueNoise,
-			   const uint32_t x,
-               const uint32_t y,
-			   const uint32_t sample,
-			   const uint32_t seed,
-			   RayHit& rayhit) noexcept;
\ No newline at end of file
+				const Settings& settings,
+				AOVs* aovs = nullptr) noexcept;
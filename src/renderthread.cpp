@@ -0,0 +1,287 @@
+#include "renderthread.h"
+
+#include <chrono>
+
+// Beyond that the blue noise sequence wraps and accumulating more samples is pointless
+constexpr uint32_t maxProgressiveSamples = 256;
+
+// Regions are given in pixels of the full resolution frame
+static RenderRegion ScaleRegion(const RenderRegion& region, const Settings& full, const Settings& scaled) noexcept
+{
+    const auto scale = [](const uint16_t coord, const uint16_t from, const uint16_t to) -> uint16_t
+        {
+            return std::min<uint32_t>((static_cast<uint32_t>(coord) * to + from - 1) / from, to);
+        };
+
+    RenderRegion result;
+    result.x_start = static_cast<uint32_t>(region.x_start) * scaled.xres / full.xres;
+    result.y_start = static_cast<uint32_t>(region.y_start) * scaled.yres / full.yres;
+    result.x_end = scale(region.x_end, full.xres, scaled.xres);
+    result.y_end = scale(region.y_end, full.yres, scaled.yres);
+
+    return result;
+}
+
+static void RenderLoop(RenderThread& renderThread) noexcept
+{
+    // All the parallel work of the frames runs in explicitly sized arenas rather than the global one
+    ThreadPools pools;
+    InitThreadPools(pools, renderThread.threads);
+
+    // Tiles and frames are split by NUMA node on multi socket machines
+    NumaTopology numa;
+    InitNumaTopology(numa, pools.settings.renderThreads);
+
+    Tiles tiles;
+    tiles.numa = &numa;
+    Settings tilesSettings;
+    bool hasParams = false;
+
+    RenderParams params;
+    Governor governor;
+    Preview preview;
+    Temporal temporal;
+    AOVs frameAOVs; // Full aovs of the frame when sparse rendering or denoising
+    Denoiser denoiser;
+    EnvMap envMap;
+    RayCache rayCache;
+    uint32_t samples = 0;
+    uint64_t frameIndex = 0;
+
+    // Last published slot, only ever read here once published
+    const Frame* lastFrame = nullptr;
+
+    while (renderThread.running.load(std::memory_order_relaxed))
+    {
+        if (renderThread.params.Acquire())
+        {
+            const RenderParams& newParams = renderThread.params.GetFront();
+
+            if (!hasParams || newParams.version != params.version) samples = 0;
+
+            params = newParams;
+            hasParams = true;
+
+            // Rebaked only when the sky changed
+            RunRender(pools, [&]() { UpdateEnvMap(envMap, params.sky); });
+            params.sky.envMap = &envMap;
+        }
+
+        const bool converged = params.settings.progressive && samples >= maxProgressiveSamples;
+
+        if (!hasParams || converged)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Progressive renders are meant to converge to the final image, the governor only runs when interactive
+        Settings settings = params.settings;
+
+        governor.settings = params.governor;
+
+        if (settings.progressive) ResetGovernor(governor);
+        else ApplyGovernor(governor, settings);
+
+        preview.settings = params.preview;
+
+        UpdatePreview(preview, params.moving);
+        ApplyPreview(preview, settings);
+
+        settings.xres = maths::max(1.0f, maths::round(params.settings.xres * settings.resolutionScale));
+        settings.yres = maths::max(1.0f, maths::round(params.settings.yres * settings.resolutionScale));
+
+        if (HasRenderRegion(params.settings)) settings.region = ScaleRegion(params.settings.region, params.settings, settings);
+
+        if (tiles.count == 0 ||
+            tilesSettings.xres != settings.xres ||
+            tilesSettings.yres != settings.yres ||
+            tilesSettings.progressive != settings.progressive)
+        {
+            ReleaseTiles(tiles);
+            GenerateTiles(tiles, settings);
+
+            tilesSettings = settings;
+            samples = 0;
+        }
+
+        // Only start accumulating once the preview has refined back to full quality
+        samples = settings.progressive && !IsPreviewing(preview) ? samples + 1 : 1;
+
+        Frame& frame = renderThread.frames.GetBack();
+
+        if (frame.buffer.data == nullptr ||
+            frame.buffer.xres != settings.xres ||
+            frame.buffer.yres != settings.yres ||
+            frame.buffer.format != params.format)
+        {
+            AllocateFrameBuffer(frame.buffer, settings.xres, settings.yres, params.format, &numa);
+
+            delete[] frame.depth;
+            frame.depth = nullptr;
+        }
+
+        if (!params.outputDepth)
+        {
+            delete[] frame.depth;
+            frame.depth = nullptr;
+        }
+        else if (frame.depth == nullptr)
+        {
+            frame.depth = new float[settings.xres * settings.yres];
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        // Outside of the region the frame shows the last completed image
+        const RenderRegion region = GetPixelRegion(settings);
+
+        if (HasRenderRegion(settings) && lastFrame != nullptr && lastFrame != &frame &&
+            lastFrame->buffer.xres == frame.buffer.xres &&
+            lastFrame->buffer.yres == frame.buffer.yres &&
+            lastFrame->buffer.format == frame.buffer.format)
+        {
+            memcpy(frame.buffer.data, lastFrame->buffer.data, GetFrameBufferSize(frame.buffer));
+
+            if (frame.depth != nullptr && lastFrame->depth != nullptr) memcpy(frame.depth, lastFrame->depth, settings.xres * settings.yres * sizeof(float));
+        }
+
+        temporal.settings = params.temporal;
+
+        denoiser.settings = params.denoise;
+
+        // All single sample techniques, progressive accumulation renders every pixel directly
+        const bool useTemporal = temporal.settings.enabled && !settings.progressive;
+        // The sparse anchors and edges are traced one pixel at a time with the single reflection, the path
+        // tracer only works on whole tiles
+        const bool useSparse = params.sparse.enabled && !settings.progressive && settings.bounces == 0;
+        const bool useDenoise = denoiser.settings.enabled && !settings.progressive;
+
+        AOVs depthAOV;
+        AOVs* aovs = nullptr;
+
+        if (useTemporal)
+        {
+            ResizeTemporal(temporal, settings.xres, settings.yres);
+            aovs = &temporal.current;
+        }
+        else
+        {
+            InvalidateTemporal(temporal);
+
+            if (useSparse || useDenoise)
+            {
+                if (frameAOVs.xres != settings.xres || frameAOVs.yres != settings.yres || frameAOVs.beauty == nullptr)
+                {
+                    AllocateAOVs(frameAOVs, settings.xres, settings.yres);
+                }
+
+                aovs = &frameAOVs;
+            }
+            else if (params.outputDepth)
+            {
+                depthAOV.depth = frame.depth;
+                depthAOV.xres = settings.xres;
+                depthAOV.yres = settings.yres;
+
+                aovs = &depthAOV;
+            }
+        }
+
+        // Temporal accumulation takes one jittered sample per frame, walking the blue noise sequence across frames
+        const uint64_t sample = useTemporal ? frameIndex + 1 : samples;
+
+        // Pure translations keep the directions of the previous frame
+        RunRender(pools, [&]() { UpdateRayCache(rayCache, params.cam, settings.xres, settings.yres, renderThread.blueNoise, sample); });
+
+        Camera cam = params.cam;
+        cam.rayCache = &rayCache;
+
+        RunRender(pools, [&]()
+            {
+                if (useSparse) RenderSparse(*aovs, params.ocean, params.sky, renderThread.blueNoise, sample, cam, settings, params.sparse);
+                else Render(frame.buffer, params.ocean, params.sky, renderThread.blueNoise, frameIndex, sample, tiles, cam, settings, aovs);
+            });
+
+        // Before the temporal accumulation so the history is made of denoised frames
+        const auto startDenoise = std::chrono::steady_clock::now();
+
+        if (useDenoise) RunDenoise(pools, [&]() { Denoise(denoiser, *aovs); });
+
+        frame.denoiseTime = useDenoise ? std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startDenoise).count() : 0.0f;
+
+        RunRender(pools, [&]()
+            {
+                if (useTemporal) ResolveTemporal(temporal, frame.buffer, params.cam, region);
+                else if (useSparse || useDenoise) ResolveAOVs(frame.buffer, *aovs, region);
+            });
+
+        if (params.outputDepth && aovs->depth != frame.depth)
+        {
+            for (uint32_t y = region.y_start; y < region.y_end; y++)
+            {
+                const size_t offset = region.x_start + y * settings.xres;
+
+                memcpy(frame.depth + offset, aovs->depth + offset, (region.x_end - region.x_start) * sizeof(float));
+            }
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+
+        frame.cam = params.cam;
+        frame.settings = settings;
+        frame.preview = IsPreviewing(preview);
+        frame.renderTime = std::chrono::duration<float, std::milli>(end - start).count();
+        frame.samples = samples;
+        frame.index = frameIndex++;
+
+        for (uint8_t i = 0; i < GovernorKnob_Count; i++) frame.governorLevels[i] = governor.levels[i];
+
+        if (!settings.progressive) UpdateGovernor(governor, frame.renderTime);
+
+        lastFrame = &frame;
+
+        renderThread.frames.Publish();
+    }
+
+    ReleaseTiles(tiles);
+    ReleaseTemporal(temporal);
+    ReleaseAOVs(frameAOVs);
+    ReleaseDenoiser(denoiser);
+    ReleaseEnvMap(envMap);
+    ReleaseRayCache(rayCache);
+    ReleaseThreadPools(pools);
+}
+
+void StartRenderThread(RenderThread& renderThread, const BlueNoise* blueNoise, const ThreadSettings& threads) noexcept
+{
+    renderThread.blueNoise = blueNoise;
+    renderThread.threads = threads;
+    renderThread.running.store(true);
+    renderThread.thread = std::thread(RenderLoop, std::ref(renderThread));
+}
+
+void StopRenderThread(RenderThread& renderThread) noexcept
+{
+    renderThread.running.store(false);
+
+    if (renderThread.thread.joinable()) renderThread.thread.join();
+
+    for (Frame& frame : renderThread.frames.slots)
+    {
+        ReleaseFrameBuffer(frame.buffer);
+
+        delete[] frame.depth;
+        frame.depth = nullptr;
+    }
+}
+
+void RestartRenderThread(RenderThread& renderThread, const ThreadSettings& threads) noexcept
+{
+    StopRenderThread(renderThread);
+
+    // Called from the consumer side, a frame published before the stop lost its buffers with it
+    renderThread.frames.Acquire();
+
+    StartRenderThread(renderThread, renderThread.blueNoise, threads);
+}
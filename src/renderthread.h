@@ -0,0 +1,90 @@
+#pragma once
+
+#include "render.h"
+#include "triplebuffer.h"
+#include "governor.h"
+#include "preview.h"
+#include "temporal.h"
+#include "sparse.h"
+#include "denoise.h"
+#include "threads.h"
+
+#include <thread>
+
+// Everything the render thread needs to produce a frame, pushed by the ui thread through a mailbox
+
+struct RenderParams
+{
+	Camera cam;
+	Ocean ocean;
+	Sky sky;
+	Settings settings;
+
+	OutputFormat format = OutputFormat::RGBA8;
+
+	GovernorSettings governor;
+	PreviewSettings preview;
+	TemporalSettings temporal;
+	SparseSettings sparse;
+	DenoiseSettings denoise;
+
+	// Set while the camera or the scene is being edited, the render thread switches to a cheap preview
+	bool moving = false;
+
+	// Also output the primary ray depth with the frames, needed by the display rate warp
+	bool outputDepth = false;
+
+	// Bumped by the ui each time something changes that invalidates progressive accumulation
+	uint32_t version = 0;
+};
+
+struct Frame
+{
+	FrameBuffer buffer;
+	float* depth = nullptr; // Only when requested by the params
+
+	Camera cam;
+	Settings settings; // Effective settings the frame has been rendered with
+
+	uint8_t governorLevels[GovernorKnob_Count] = { 0, 0, 0, 0 };
+
+	bool preview = false;
+
+	float renderTime = 0.0f; // ms, denoising included
+	float denoiseTime = 0.0f; // ms
+	uint32_t samples = 0;
+	uint64_t index = 0;
+};
+
+struct RenderThread
+{
+	TripleBuffer<RenderParams> params;
+	TripleBuffer<Frame> frames;
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	const BlueNoise* blueNoise = nullptr;
+
+	ThreadSettings threads;
+};
+
+void StartRenderThread(RenderThread& renderThread, const BlueNoise* blueNoise, const ThreadSettings& threads = ThreadSettings()) noexcept;
+
+void StopRenderThread(RenderThread& renderThread) noexcept;
+
+// Recreates the thread pools with the new settings, the frames in flight are dropped
+void RestartRenderThread(RenderThread& renderThread, const ThreadSettings& threads) noexcept;
+
+// Ui side helpers
+
+FORCEINLINE void PushRenderParams(RenderThread& renderThread, const RenderParams& params) noexcept
+{
+	renderThread.params.GetBack() = params;
+	renderThread.params.Publish();
+}
+
+FORCEINLINE const Frame* AcquireFrame(RenderThread& renderThread) noexcept
+{
+	return renderThread.frames.Acquire() ? &renderThread.frames.GetFront() : nullptr;
+}
@@ -205,23 +205,21 @@ inline void PcgSampler8(float* randoms, unsigned int* state) noexcept
 
 // Eric Heitz optimised blue noise sampling function https://eheitzresearch.wordpress.com/762-2/
 
-inline uint32_t* LoadBlueNoise()
+// The samplers read the constexpr tables of bluenoise.h in place, nothing is copied or allocated
+struct BlueNoise
 {
-    uint32_t* data = new uint32_t[65536 * 5];
+    const uint8_t* sequence; // 256 samples of 256 dimensions
+    const uint8_t* tiles;    // 8 ranking then 8 scrambling keys per pixel of the 128x128 tile
+};
 
-    const uint8_t* data8 = sobol_256spp_256d;
-    for(uint32_t i = 0; i < 65536; i++) data[i] = data8[i];
+inline constexpr BlueNoise blueNoiseTables = { sobol_256spp_256d, blueNoiseTiles };
 
-    data8 = scramblingTile;
-    for(uint32_t i = 0; i < (128 * 128 * 8); i++) data[i + 65536] = data8[i];
-
-    data8 = rankingTile;
-    for(uint32_t i = 0; i < (128 * 128 * 8); i++) data[i + 3 * 65536] = data8[i];
-
-    return data;
+inline const BlueNoise* LoadBlueNoise() noexcept
+{
+    return &blueNoiseTables;
 }
 
-inline float BlueNoiseSamplerSpp(const uint32_t* blueNoise, uint32_t x, uint32_t y, uint32_t sampleIndex, uint32_t sampleDimension) noexcept
+inline float BlueNoiseSamplerSpp(const BlueNoise* blueNoise, uint32_t x, uint32_t y, uint32_t sampleIndex, uint32_t sampleDimension) noexcept
 {
 	// wrap arguments
 	x = x & 127;
@@ -229,14 +227,17 @@ inline float BlueNoiseSamplerSpp(const uint32_t* blueNoise, uint32_t x, uint32_t
 	sampleIndex = sampleIndex & 255;
 	sampleDimension = sampleDimension & 255;
 
+	// Keys of the pixel, the ranking and the scrambling ones are next to each other
+	const uint8_t* keys = blueNoise->tiles + (x + y * 128) * 16;
+
 	// xor index based on optimized ranking
-	const uint32_t rankedSampleIndex = sampleIndex ^ blueNoise[sampleDimension + (x + y * 128) * 8 + 65536 * 3];
+	const uint32_t rankedSampleIndex = sampleIndex ^ keys[sampleDimension & 7];
 
 	// fetch value in sequence
-	uint32_t value = blueNoise[sampleDimension + rankedSampleIndex * 256];
+	uint32_t value = blueNoise->sequence[sampleDimension + rankedSampleIndex * 256];
 
 	// If the dimension is optimized, xor sequence value based on optimized scrambling
-	value = value ^ blueNoise[(sampleDimension%8) + (x + y * 128) * 8 + 65536];
+	value = value ^ keys[8 + (sampleDimension & 7)];
 
 	// convert to float and return
 	return (0.5f + value) / 256.0f;
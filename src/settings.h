@@ -1,11 +1,37 @@
 #pragma once
 
+#include "ocean.h"
+
 #include <stdint.h>
 
+// Pixel rect [x_start, x_end) x [y_start, y_end) of the frame, empty for the whole frame
+struct RenderRegion
+{
+	uint16_t x_start = 0;
+	uint16_t y_start = 0;
+	uint16_t x_end = 0;
+	uint16_t y_end = 0;
+};
+
 struct Settings
 {
 	float time = 0.0f;
 
+	// Accumulates samples over frames in the tiles scratch buffers, otherwise pixels go straight to the output
+	bool progressive = false;
+
 	uint16_t xres;
 	uint16_t yres;
+
+	// Only the tiles overlapping the region are rendered, the rest of the output keeps what it holds
+	RenderRegion region;
+
+	// Quality knobs, lowered by the frame time governor when interactive
+	float resolutionScale = 1.0f;
+	uint8_t raymarchOctaves = ITERATIONS_RAYMARCH;
+	uint8_t normalOctaves = ITERATIONS_NORMAL;
+	uint16_t maxMarchSteps = MAX_RAYMARCH_STEPS;
+
+	// Path traces the ocean with up to this many bounces, 0 only shades the reflection of the sky
+	uint8_t bounces = 0;
 };
\ No newline at end of file
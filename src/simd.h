@@ -3,7 +3,10 @@
 // Simple simd library using sse, avx and avx2 intrinsics
 
 #include "immintrin.h"
+
+#ifdef _MSC_VER
 #include "intrin.h"
+#endif
 
 #include "decl.h"
 
@@ -19,4 +22,86 @@ using vmask64 = __mmask64;
 FORCEINLINE vfloat4 load(const float* ptr) { return _mm_load_ps(ptr); }
 FORCEINLINE vfloat4 loadu(const float* ptr) { return _mm_loadu_ps(ptr); }
 FORCEINLINE void store(float* ptr, const vfloat4& v) { return _mm_store_ps(ptr, v); }
-FORCEINLINE void storeu(float* ptr, const vfloat4& v) { return _mm_storeu_ps(ptr, v); }
\ No newline at end of file
+FORCEINLINE void storeu(float* ptr, const vfloat4& v) { return _mm_storeu_ps(ptr, v); }
+
+// 8 wide
+
+FORCEINLINE vfloat8 load8(const float* ptr) { return _mm256_load_ps(ptr); }
+FORCEINLINE vfloat8 loadu8(const float* ptr) { return _mm256_loadu_ps(ptr); }
+FORCEINLINE void store8(float* ptr, const vfloat8& v) { return _mm256_store_ps(ptr, v); }
+FORCEINLINE void storeu8(float* ptr, const vfloat8& v) { return _mm256_storeu_ps(ptr, v); }
+
+FORCEINLINE vfloat8 set8(const float f) { return _mm256_set1_ps(f); }
+FORCEINLINE vfloat8 iota8() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+
+FORCEINLINE vfloat8 add8(const vfloat8& a, const vfloat8& b) { return _mm256_add_ps(a, b); }
+FORCEINLINE vfloat8 sub8(const vfloat8& a, const vfloat8& b) { return _mm256_sub_ps(a, b); }
+FORCEINLINE vfloat8 mul8(const vfloat8& a, const vfloat8& b) { return _mm256_mul_ps(a, b); }
+FORCEINLINE vfloat8 div8(const vfloat8& a, const vfloat8& b) { return _mm256_div_ps(a, b); }
+FORCEINLINE vfloat8 fmadd8(const vfloat8& a, const vfloat8& b, const vfloat8& c) { return _mm256_fmadd_ps(a, b, c); }
+FORCEINLINE vfloat8 min8(const vfloat8& a, const vfloat8& b) { return _mm256_min_ps(a, b); }
+FORCEINLINE vfloat8 max8(const vfloat8& a, const vfloat8& b) { return _mm256_max_ps(a, b); }
+FORCEINLINE vfloat8 sqrt8(const vfloat8& a) { return _mm256_sqrt_ps(a); }
+FORCEINLINE vfloat8 clamp8(const vfloat8& a) { return min8(max8(a, _mm256_setzero_ps()), set8(1.0f)); }
+
+// Per lane mask ? a : b
+FORCEINLINE vfloat8 select8(const vfloat8& mask, const vfloat8& a, const vfloat8& b) { return _mm256_blendv_ps(b, a, mask); }
+FORCEINLINE vfloat8 gt8(const vfloat8& a, const vfloat8& b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+
+// Cephes based log2 and exp2, a few ulps of error on the whole float range
+
+FORCEINLINE vfloat8 log2_8(const vfloat8& x)
+{
+    const vint8 bits = _mm256_castps_si256(x);
+
+    // x = m * 2^e with m in [0.5, 1)
+    vfloat8 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+    vfloat8 m = _mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF))), set8(0.5f));
+
+    // Shift m to [sqrt(0.5), sqrt(2)) so the polynomial is evaluated around 1
+    const vfloat8 small = _mm256_cmp_ps(m, set8(0.707106781186547524f), _CMP_LT_OQ);
+    e = sub8(e, _mm256_and_ps(small, set8(1.0f)));
+    m = sub8(add8(m, _mm256_and_ps(small, m)), set8(1.0f));
+
+    const vfloat8 z = mul8(m, m);
+
+    vfloat8 y = set8(7.0376836292e-2f);
+    y = fmadd8(y, m, set8(-1.1514610310e-1f));
+    y = fmadd8(y, m, set8(1.1676998740e-1f));
+    y = fmadd8(y, m, set8(-1.2420140846e-1f));
+    y = fmadd8(y, m, set8(1.4249322787e-1f));
+    y = fmadd8(y, m, set8(-1.6668057665e-1f));
+    y = fmadd8(y, m, set8(2.0000714765e-1f));
+    y = fmadd8(y, m, set8(-2.4999993993e-1f));
+    y = fmadd8(y, m, set8(3.3333331174e-1f));
+    y = mul8(mul8(y, m), z);
+    y = fmadd8(z, set8(-0.5f), y);
+
+    // ln(m) * log2(e) + e
+    return fmadd8(add8(m, y), set8(1.44269504088896341f), e);
+}
+
+FORCEINLINE vfloat8 exp2_8(const vfloat8& x)
+{
+    // Below -126 the result is flushed to zero
+    const vfloat8 underflow = _mm256_cmp_ps(x, set8(-126.0f), _CMP_LT_OQ);
+    const vfloat8 xc = min8(max8(x, set8(-126.0f)), set8(127.0f));
+
+    const vfloat8 n = _mm256_round_ps(xc, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const vfloat8 f = sub8(xc, n);
+
+    vfloat8 p = set8(1.535336188319500e-4f);
+    p = fmadd8(p, f, set8(1.339887440266574e-3f));
+    p = fmadd8(p, f, set8(9.618437357674640e-3f));
+    p = fmadd8(p, f, set8(5.550332471162809e-2f));
+    p = fmadd8(p, f, set8(2.402264791363012e-1f));
+    p = fmadd8(p, f, set8(6.931472028550421e-1f));
+    p = fmadd8(p, f, set8(1.0f));
+
+    const vint8 scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+
+    return _mm256_andnot_ps(underflow, mul8(p, _mm256_castsi256_ps(scale)));
+}
+
+// x^y for x > 0
+FORCEINLINE vfloat8 pow8(const vfloat8& x, const vfloat8& y) { return exp2_8(mul8(y, log2_8(x))); }
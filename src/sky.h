@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vec3.h"
+#include "simd.h"
 
 struct Sun
 {
@@ -8,23 +9,98 @@ struct Sun
     vec3 color = vec3(2.0f, 2.0f, 2.0f);
 };
 
+// The sun is a cos^n lobe around its direction rather than a disk
+static constexpr float sunExponent = 1000.0f;
+
+struct EnvMap;
+
 struct Sky
 {
     Sun sun;
 
     vec3 color1 = vec3(0.5f, 0.7f, 1.0f);
     vec3 color2 = vec3(0.1f, 0.2f, 0.3f);
+
+    // Baked version of the above, used by the reflections when set
+    const EnvMap* envMap = nullptr;
 };
 
 FORCEINLINE vec3 SampleSun(const vec3& direction, const Sun& sun) noexcept
 {
     const float sunDot = dot(direction, sun.direction);
-    const float intensity = sunDot > 0.0f ? maths::pow(maths::clamp(sunDot), 1000.0f) : maths::constants::zero;
+    const float intensity = sunDot > 0.0f ? maths::pow(maths::clamp(sunDot), sunExponent) : maths::constants::zero;
 
     return sun.color * intensity;
 }
 
+// Density of SampleSunDirection, proportional to the sun lobe
+FORCEINLINE float SunPdf(const vec3& direction, const Sun& sun) noexcept
+{
+    const float sunDot = dot(direction, sun.direction);
+
+    return sunDot > 0.0f ? (sunExponent + 1.0f) / (2.0f * maths::constants::pi) * maths::pow(maths::clamp(sunDot), sunExponent) : 0.0f;
+}
+
+// Samples the cone of the sun with the distribution of its lobe, so the radiance over the pdf is a constant
+FORCEINLINE vec3 SampleSunDirection(const Sun& sun, const float u, const float v, float& pdf) noexcept
+{
+    const vec3& axis = sun.direction;
+
+    const float cosTheta = maths::pow(u, 1.0f / (sunExponent + 1.0f));
+    const float sinTheta = maths::sqrt(maths::max(0.0f, 1.0f - cosTheta * cosTheta));
+    const float phi = 2.0f * maths::constants::pi * v;
+
+    // Orthonormal basis around the axis
+    const float sign = axis.z >= 0.0f ? 1.0f : -1.0f;
+    const float a = -1.0f / (sign + axis.z);
+    const float b = axis.x * axis.y * a;
+    const vec3 b1 = vec3(1.0f + sign * axis.x * axis.x * a, sign * b, -sign * axis.x);
+    const vec3 b2 = vec3(b, sign + axis.y * axis.y * a, -axis.y);
+
+    pdf = (sunExponent + 1.0f) / (2.0f * maths::constants::pi) * maths::pow(cosTheta, sunExponent);
+
+    return normalize((b1 * maths::cos(phi) + b2 * maths::sin(phi)) * sinTheta + axis * cosTheta);
+}
+
+// Sky without the sun
+FORCEINLINE vec3 SampleSkyGradient(const vec3& direction, const Sky& sky) noexcept
+{
+    return lerp(sky.color1, sky.color2, maths::pow(maths::clamp(direction.y), 0.75f));
+}
+
 FORCEINLINE vec3 SampleSky(const vec3& direction, const Sky& sky) noexcept
 {
-    return lerp(sky.color1, sky.color2, maths::pow(maths::clamp(direction.y), 0.75f)) + SampleSun(direction, sky.sun);
-}
\ No newline at end of file
+    return SampleSkyGradient(direction, sky) + SampleSun(direction, sky.sun);
+}
+
+// SampleSky for 8 directions at once, the pows are evaluated as exp2(y * log2(x))
+FORCEINLINE void SampleSky8(const vfloat8& dx, 
+                            const vfloat8& dy, 
+                            const vfloat8& dz, 
+                            const Sky& sky, 
+                            vfloat8& r, 
+                            vfloat8& g, 
+                            vfloat8& b) noexcept
+{
+    const vfloat8 zero = _mm256_setzero_ps();
+
+    const vfloat8 up = clamp8(dy);
+    const vfloat8 t = select8(gt8(up, zero), pow8(up, set8(0.75f)), zero);
+
+    const vfloat8 sunDot = fmadd8(dx, set8(sky.sun.direction.x), fmadd8(dy, set8(sky.sun.direction.y), mul8(dz, set8(sky.sun.direction.z))));
+    const vfloat8 intensity = select8(gt8(sunDot, zero), pow8(clamp8(sunDot), set8(sunExponent)), zero);
+
+    r = fmadd8(t, set8(sky.color2.x - sky.color1.x), fmadd8(intensity, set8(sky.sun.color.x), set8(sky.color1.x)));
+    g = fmadd8(t, set8(sky.color2.y - sky.color1.y), fmadd8(intensity, set8(sky.sun.color.y), set8(sky.color1.y)));
+    b = fmadd8(t, set8(sky.color2.z - sky.color1.z), fmadd8(intensity, set8(sky.sun.color.z), set8(sky.color1.z)));
+}
+
+// Sun lobe alone for 8 directions, the color is left to the caller
+FORCEINLINE vfloat8 SampleSunIntensity8(const vfloat8& dx, const vfloat8& dy, const vfloat8& dz, const Sun& sun) noexcept
+{
+    const vfloat8 zero = _mm256_setzero_ps();
+
+    const vfloat8 sunDot = fmadd8(dx, set8(sun.direction.x), fmadd8(dy, set8(sun.direction.y), mul8(dz, set8(sun.direction.z))));
+
+    return select8(gt8(sunDot, zero), pow8(clamp8(sunDot), set8(sunExponent)), zero);
+}
@@ -0,0 +1,207 @@
+#include "sparse.h"
+
+FORCEINLINE bool IsAnchor(const uint32_t coord, const uint32_t res, const uint32_t stride) noexcept
+{
+    // The last row and column are always traced so every pixel has anchors on both sides
+    return coord % stride == 0 || coord == res - 1;
+}
+
+// Cheap guide, distance along the ray to the mean height of the waves
+FORCEINLINE float GuideDepth(const Ocean& ocean, const vec3& origin, const vec3& direction) noexcept
+{
+    const float height = -0.5f * ocean.depth;
+
+    if (direction.y >= 0.0f || origin.y <= height) return maths::constants::inf;
+
+    return (origin.y - height) / -direction.y;
+}
+
+FORCEINLINE void StorePixel(AOVs& aovs, const uint32_t index, const PixelSample& pixel) noexcept
+{
+    aovs.beauty[index] = { pixel.color.x, pixel.color.y, pixel.color.z };
+    aovs.position[index] = pixel.position;
+    aovs.normal[index] = pixel.normal;
+    aovs.depth[index] = pixel.depth;
+}
+
+void RenderSparse(AOVs& aovs,
+                  const Ocean& ocean,
+                  const Sky& sky,
+                  const BlueNoise* blueNoise,
+                  const uint64_t& sample,
+                  const Camera& cam,
+                  const Settings& settings,
+                  const SparseSettings& sparse) noexcept
+{
+    const uint32_t xres = settings.xres;
+    const uint32_t yres = settings.yres;
+    const uint32_t stride = maths::max(1.0f, sparse.stride);
+
+    // The pixels of the region need the anchors enclosing them, which can be up to a block outside of it
+    const RenderRegion region = GetPixelRegion(settings);
+
+    const uint32_t anchorXStart = region.x_start - region.x_start % stride;
+    const uint32_t anchorYStart = region.y_start - region.y_start % stride;
+    const uint32_t anchorXEnd = std::min<uint32_t>(region.x_end + stride, xres);
+    const uint32_t anchorYEnd = std::min<uint32_t>(region.y_end + stride, yres);
+
+    WaveTable waves;
+    const Ocean frameOcean = PrepareFrameOcean(ocean, waves, settings);
+
+    // Trace the anchors
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(anchorYStart, anchorYEnd), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                if (!IsAnchor(y, yres, stride)) continue;
+
+                for (uint32_t x = anchorXStart; x < anchorXEnd; x++)
+                {
+                    if (!IsAnchor(x, xres, stride)) continue;
+
+                    PixelSample pixel;
+                    TracePixel(pixel, frameOcean, sky, blueNoise, sample, cam, settings, x, y);
+
+                    StorePixel(aovs, x + y * xres, pixel);
+                }
+            }
+        });
+
+    // Trace the pixels around the edges and upsample the rest. Both only read the anchors, so one pass is enough
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(region.y_start, region.y_end), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                const bool anchorRow = IsAnchor(y, yres, stride);
+                const uint32_t y0 = y - y % stride;
+                const uint32_t y1 = anchorRow ? y : std::min(y0 + stride, yres - 1);
+
+                for (uint32_t x = region.x_start; x < region.x_end; x++)
+                {
+                    const bool anchorColumn = IsAnchor(x, xres, stride);
+
+                    if (anchorRow && anchorColumn) continue;
+
+                    const uint32_t x0 = anchorColumn ? x : x - x % stride;
+                    const uint32_t x1 = anchorColumn ? x : std::min(x0 + stride, xres - 1);
+
+                    const uint32_t anchors[4] = { x0 + y0 * xres, x1 + y0 * xres, x0 + y1 * xres, x1 + y1 * xres };
+
+                    const float fx = x1 > x0 ? static_cast<float>(x - x0) / static_cast<float>(x1 - x0) : 0.0f;
+                    const float fy = y1 > y0 ? static_cast<float>(y - y0) / static_cast<float>(y1 - y0) : 0.0f;
+                    const float bilinear[4] = { (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy };
+
+                    // Edge detection over the enclosing anchors
+                    uint32_t skyCount = 0;
+                    float minDepth = maths::constants::inf;
+                    float maxDepth = 0.0f;
+                    vec3 meanNormal = vec3(maths::constants::zero);
+
+                    for (uint32_t i = 0; i < 4; i++)
+                    {
+                        const float depth = aovs.depth[anchors[i]];
+
+                        if (depth == maths::constants::inf)
+                        {
+                            skyCount++;
+                            continue;
+                        }
+
+                        minDepth = maths::min(minDepth, depth);
+                        maxDepth = maths::max(maxDepth, depth);
+                        meanNormal += aovs.normal[anchors[i]];
+                    }
+
+                    const uint32_t index = x + y * xres;
+
+                    if (skyCount == 4)
+                    {
+                        // The sky is cheap enough to be evaluated everywhere
+                        const vec3 direction = PrimaryDirection(cam, x + 0.5f, y + 0.5f, xres, yres);
+
+                        PixelSample pixel;
+                        pixel.color = SampleSky(direction, sky);
+                        pixel.position = cam.pos + direction * skyDistance;
+
+                        StorePixel(aovs, index, pixel);
+                        continue;
+                    }
+
+                    meanNormal = normalize(meanNormal);
+
+                    bool edge = skyCount > 0 || maxDepth > minDepth * (1.0f + sparse.depthThreshold);
+
+                    for (uint32_t i = 0; i < 4 && !edge; i++)
+                    {
+                        edge = dot(aovs.normal[anchors[i]], meanNormal) < sparse.normalThreshold;
+                    }
+
+                    if (edge)
+                    {
+                        PixelSample pixel;
+                        TracePixel(pixel, frameOcean, sky, blueNoise, sample, cam, settings, x, y);
+
+                        StorePixel(aovs, index, pixel);
+                        continue;
+                    }
+
+                    // Joint bilateral upsampling
+                    const vec3 direction = PrimaryDirection(cam, x + 0.5f, y + 0.5f, xres, yres);
+                    const float guide = GuideDepth(ocean, cam.pos, direction);
+
+                    vec3 colorSum = vec3(maths::constants::zero);
+                    vec3 normalSum = vec3(maths::constants::zero);
+                    float depthSum = 0.0f;
+                    float weightSum = 0.0f;
+
+                    for (uint32_t i = 0; i < 4; i++)
+                    {
+                        const uint32_t anchor = anchors[i];
+
+                        const vec3 anchorDirection = PrimaryDirection(cam, anchor % xres + 0.5f, anchor / xres + 0.5f, xres, yres);
+                        const float anchorGuide = GuideDepth(ocean, cam.pos, anchorDirection);
+
+                        float depthWeight = 1.0f;
+
+                        if (guide != maths::constants::inf && anchorGuide != maths::constants::inf)
+                        {
+                            const float d = (guide - anchorGuide) / (guide * sparse.depthSigma);
+                            depthWeight = maths::exp(-d * d);
+                        }
+
+                        const float normalWeight = maths::pow(maths::max(0.0f, dot(aovs.normal[anchor], meanNormal)), sparse.normalPower);
+
+                        const float weight = bilinear[i] * depthWeight * normalWeight;
+
+                        const color& c = aovs.beauty[anchor];
+
+                        colorSum += vec3(c.R, c.G, c.B) * weight;
+                        normalSum += aovs.normal[anchor] * weight;
+                        depthSum += aovs.depth[anchor] * weight;
+                        weightSum += weight;
+                    }
+
+                    PixelSample pixel;
+
+                    if (weightSum > 1e-6f)
+                    {
+                        pixel.color = colorSum / weightSum;
+                        pixel.normal = normalize(normalSum);
+                        pixel.depth = depthSum / weightSum;
+                    }
+                    else
+                    {
+                        const color& c = aovs.beauty[anchors[0]];
+
+                        pixel.color = vec3(c.R, c.G, c.B);
+                        pixel.normal = aovs.normal[anchors[0]];
+                        pixel.depth = aovs.depth[anchors[0]];
+                    }
+
+                    pixel.position = cam.pos + direction * pixel.depth;
+
+                    StorePixel(aovs, index, pixel);
+                }
+            }
+        });
+}
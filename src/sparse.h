@@ -0,0 +1,29 @@
+#pragma once
+
+#include "render.h"
+
+// Edge-aware sparse rendering. Only one pixel per stride x stride block is traced, plus every pixel whose
+// surrounding traced pixels disagree on sky/ocean, depth or normal. The remaining pixels are reconstructed
+// with a joint bilateral upsampling of the traced ones, guided by the depth to the mean ocean plane and
+// the traced normals, so the horizon and the wave silhouettes stay sharp
+
+struct SparseSettings
+{
+    bool enabled = false;
+
+    uint8_t stride = 2;             // Distance between the traced pixels, 2 traces 1 pixel in 4
+    float normalThreshold = 0.95f;  // Cosine between the traced normals below which the block is fully traced
+    float depthThreshold = 0.1f;    // Relative depth range above which the block is fully traced
+    float depthSigma = 0.05f;       // Relative depth falloff of the upsampling weights
+    float normalPower = 8.0f;       // Normal falloff of the upsampling weights
+};
+
+// Renders into the aovs, they need all their planes allocated at the resolution of the settings
+void RenderSparse(AOVs& aovs,
+                  const Ocean& ocean,
+                  const Sky& sky,
+                  const BlueNoise* blueNoise,
+                  const uint64_t& sample,
+                  const Camera& cam,
+                  const Settings& settings,
+                  const SparseSettings& sparse) noexcept;
@@ -0,0 +1,163 @@
+#include "temporal.h"
+
+void ResizeTemporal(Temporal& temporal, const uint16_t xres, const uint16_t yres) noexcept
+{
+    if (temporal.xres == xres && temporal.yres == yres && temporal.history != nullptr) return;
+
+    ReleaseTemporal(temporal);
+
+    temporal.xres = xres;
+    temporal.yres = yres;
+
+    AllocateAOVs(temporal.current, xres, yres);
+
+    // Cleared, the pixels outside of a render region keep carrying the initial history
+    temporal.history = new color[xres * yres]();
+    temporal.historyDepth = new float[xres * yres]();
+    temporal.resolved = new color[xres * yres]();
+    temporal.resolvedDepth = new float[xres * yres]();
+
+    temporal.valid = false;
+}
+
+void ReleaseTemporal(Temporal& temporal) noexcept
+{
+    ReleaseAOVs(temporal.current);
+
+    delete[] temporal.history;
+    temporal.history = nullptr;
+
+    delete[] temporal.historyDepth;
+    temporal.historyDepth = nullptr;
+
+    delete[] temporal.resolved;
+    temporal.resolved = nullptr;
+
+    delete[] temporal.resolvedDepth;
+    temporal.resolvedDepth = nullptr;
+
+    temporal.valid = false;
+}
+
+FORCEINLINE vec3 ToVec3(const color& c) noexcept { return vec3(c.R, c.G, c.B); }
+
+// Fetches the reprojected history, returns false if it falls outside the previous frame or got disoccluded
+FORCEINLINE bool SampleHistory(const Temporal& temporal,
+                               const mat44& previousInverse,
+                               const vec3& position,
+                               const float depth,
+                               vec3& history) noexcept
+{
+    float px, py;
+
+    if (!ProjectToScreen(temporal.previousCam, previousInverse, position, temporal.xres, temporal.yres, px, py)) return false;
+
+    // Pixel centers are at half integer coordinates
+    px -= 0.5f;
+    py -= 0.5f;
+
+    if (px < 0.0f || py < 0.0f || px > temporal.xres - 1 || py > temporal.yres - 1) return false;
+
+    const uint32_t x0 = static_cast<uint32_t>(px);
+    const uint32_t y0 = static_cast<uint32_t>(py);
+    const uint32_t x1 = std::min<uint32_t>(x0 + 1, temporal.xres - 1);
+    const uint32_t y1 = std::min<uint32_t>(y0 + 1, temporal.yres - 1);
+
+    const float fx = px - x0;
+    const float fy = py - y0;
+
+    // Disocclusion test against the depth the previous camera saw at this location
+    const uint32_t nearest = (fx < 0.5f ? x0 : x1) + (fy < 0.5f ? y0 : y1) * temporal.xres;
+    const float previousDepth = temporal.historyDepth[nearest];
+
+    if (depth == maths::constants::inf || previousDepth == maths::constants::inf)
+    {
+        if (depth != previousDepth) return false;
+    }
+    else
+    {
+        const float expectedDepth = dist(temporal.previousCam.pos, position);
+
+        if (maths::abs(expectedDepth - previousDepth) > expectedDepth * temporal.settings.depthTolerance) return false;
+    }
+
+    const vec3 top = lerp(ToVec3(temporal.history[x0 + y0 * temporal.xres]), ToVec3(temporal.history[x1 + y0 * temporal.xres]), fx);
+    const vec3 bottom = lerp(ToVec3(temporal.history[x0 + y1 * temporal.xres]), ToVec3(temporal.history[x1 + y1 * temporal.xres]), fx);
+
+    history = lerp(top, bottom, fy);
+
+    return true;
+}
+
+void ResolveTemporal(Temporal& temporal, FrameBuffer& buffer, const Camera& cam, const RenderRegion& region) noexcept
+{
+    constexpr float gamma = 1.0f / 2.2f;
+
+    const mat44 previousInverse = inverse_linear(temporal.previousCam.transformation_matrix);
+
+    const AOVs& current = temporal.current;
+    const int xres = temporal.xres;
+    const int yres = temporal.yres;
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, yres), [&](const tbb::blocked_range<int>& r)
+        {
+            for (int y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                const bool rowInRegion = y >= region.y_start && y < region.y_end;
+
+                for (int x = 0; x < xres; x++)
+                {
+                    const uint32_t index = x + y * xres;
+
+                    // The current aovs are stale there, the history carries over to the next frame
+                    if (!rowInRegion || x < region.x_start || x >= region.x_end)
+                    {
+                        temporal.resolved[index] = temporal.history[index];
+                        temporal.resolvedDepth[index] = temporal.historyDepth[index];
+                        continue;
+                    }
+
+                    const vec3 sample = ToVec3(current.beauty[index]);
+
+                    vec3 output = sample;
+                    vec3 history;
+
+                    if (temporal.valid && SampleHistory(temporal, previousInverse, current.position[index], current.depth[index], history))
+                    {
+                        // Neighbourhood clamping rejects most of the ghosting left by the reprojection
+                        vec3 neighbourMin = sample;
+                        vec3 neighbourMax = sample;
+
+                        for (int dy = -1; dy <= 1; dy++)
+                        {
+                            for (int dx = -1; dx <= 1; dx++)
+                            {
+                                const int nx = std::clamp(x + dx, 0, xres - 1);
+                                const int ny = std::clamp(y + dy, 0, yres - 1);
+
+                                const vec3 neighbour = ToVec3(current.beauty[nx + ny * xres]);
+
+                                neighbourMin = min(neighbourMin, neighbour);
+                                neighbourMax = max(neighbourMax, neighbour);
+                            }
+                        }
+
+                        history = min(max(history, neighbourMin), neighbourMax);
+
+                        output = lerp(history, sample, temporal.settings.blend);
+                    }
+
+                    temporal.resolved[index] = { output.x, output.y, output.z };
+                    temporal.resolvedDepth[index] = current.depth[index];
+
+                    SetFrameBufferPixel(buffer, index, powvec3(output, gamma));
+                }
+            }
+        });
+
+    std::swap(temporal.history, temporal.resolved);
+    std::swap(temporal.historyDepth, temporal.resolvedDepth);
+
+    temporal.previousCam = cam;
+    temporal.valid = true;
+}
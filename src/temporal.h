@@ -0,0 +1,45 @@
+#pragma once
+
+#include "render.h"
+
+// Temporal accumulation across camera motion. Each frame is rendered at one jittered sample per pixel into
+// the aovs, the previous resolved frame is reprojected through the old and new cameras using the hit
+// positions, clamped to the current neighbourhood and blended with the new sample
+
+struct TemporalSettings
+{
+    bool enabled = false;
+
+    float blend = 0.1f;           // Weight of the current frame
+    float depthTolerance = 0.05f; // Relative depth difference above which the history is considered disoccluded
+};
+
+struct Temporal
+{
+    TemporalSettings settings;
+
+    AOVs current;
+
+    color* history = nullptr;
+    float* historyDepth = nullptr;
+    color* resolved = nullptr;
+    float* resolvedDepth = nullptr;
+
+    Camera previousCam;
+
+    uint16_t xres = 0;
+    uint16_t yres = 0;
+
+    bool valid = false;
+};
+
+// Reallocates the buffers if the resolution changed, which also drops the history
+void ResizeTemporal(Temporal& temporal, const uint16_t xres, const uint16_t yres) noexcept;
+
+void ReleaseTemporal(Temporal& temporal) noexcept;
+
+FORCEINLINE void InvalidateTemporal(Temporal& temporal) noexcept { temporal.valid = false; }
+
+// Blends the current aovs with the reprojected history, writes the result to the framebuffer and keeps
+// it as the history of the next frame. Outside of the region the framebuffer and the history are left as is
+void ResolveTemporal(Temporal& temporal, FrameBuffer& buffer, const Camera& cam, const RenderRegion& region) noexcept;
@@ -0,0 +1,132 @@
+#include "threads.h"
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Affinity of a thread before it got pinned, restored when it leaves the arena so the TBB workers serving other
+// arenas afterwards are not stuck on a core. The arenas are never nested, one saved affinity per thread is enough
+struct SavedAffinity
+{
+#ifdef _MSC_VER
+    DWORD_PTR mask = 0;
+#else
+    cpu_set_t set;
+#endif
+    bool saved = false;
+};
+
+static thread_local SavedAffinity savedAffinity;
+
+static void SaveCurrentAffinity() noexcept
+{
+#ifdef _MSC_VER
+    // There is no getter for the thread mask, the process one is what the threads start with
+    DWORD_PTR systemMask;
+    savedAffinity.saved = GetProcessAffinityMask(GetCurrentProcess(), &savedAffinity.mask, &systemMask) != 0;
+#else
+    savedAffinity.saved = pthread_getaffinity_np(pthread_self(), sizeof(savedAffinity.set), &savedAffinity.set) == 0;
+#endif
+}
+
+static void RestoreCurrentAffinity() noexcept
+{
+    if (!savedAffinity.saved) return;
+
+#ifdef _MSC_VER
+    SetThreadAffinityMask(GetCurrentThread(), savedAffinity.mask);
+#else
+    pthread_setaffinity_np(pthread_self(), sizeof(savedAffinity.set), &savedAffinity.set);
+#endif
+
+    savedAffinity.saved = false;
+}
+
+// Pins the threads entering an arena to consecutive cores, by their slot in the arena
+struct PinningObserver : public tbb::task_scheduler_observer
+{
+    uint32_t firstCore;
+    uint32_t coreCount;
+
+    PinningObserver(tbb::task_arena& arena, const uint32_t first, const uint32_t count) :
+        tbb::task_scheduler_observer(arena), firstCore(first), coreCount(count)
+    {
+        observe(true);
+    }
+
+    void on_scheduler_entry(bool) override
+    {
+        const int slot = tbb::this_task_arena::current_thread_index();
+
+        if (slot < 0) return;
+
+        SaveCurrentAffinity();
+        PinCurrentThread(firstCore + static_cast<uint32_t>(slot) % coreCount);
+    }
+
+    void on_scheduler_exit(bool) override
+    {
+        RestoreCurrentAffinity();
+    }
+};
+
+bool PinCurrentThread(const uint32_t core) noexcept
+{
+#ifdef _MSC_VER
+    if (core >= 64) return false;
+
+    return SetThreadAffinityMask(GetCurrentThread(), 1ull << core) != 0;
+#else
+    if (core >= CPU_SETSIZE) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+void InitThreadPools(ThreadPools& pools, const ThreadSettings& settings) noexcept
+{
+    ReleaseThreadPools(pools);
+
+    pools.settings = settings;
+
+    if (pools.settings.renderThreads == 0) pools.settings.renderThreads = tbb::info::default_concurrency();
+
+    // The render arena reserves one slot for the thread executing the frames, which is one of its threads
+    pools.render.initialize(pools.settings.renderThreads, 1);
+
+    if (pools.settings.denoiseThreads > 0) pools.denoise.initialize(pools.settings.denoiseThreads, 1);
+
+    if (!pools.settings.pin) return;
+
+    pools.renderPinning = new PinningObserver(pools.render, pools.settings.firstCore, pools.settings.renderThreads);
+
+    if (pools.settings.denoiseThreads > 0)
+    {
+        pools.denoisePinning = new PinningObserver(pools.denoise, pools.settings.firstCore + pools.settings.renderThreads, pools.settings.denoiseThreads);
+    }
+}
+
+void ReleaseThreadPools(ThreadPools& pools) noexcept
+{
+    // Observers go before their arenas
+    delete pools.renderPinning;
+    pools.renderPinning = nullptr;
+
+    delete pools.denoisePinning;
+    pools.denoisePinning = nullptr;
+
+    if (pools.render.is_active()) pools.render.terminate();
+    if (pools.denoise.is_active()) pools.denoise.terminate();
+}
+
+uint32_t GetNextFreeCore(const ThreadPools& pools) noexcept
+{
+    return pools.settings.firstCore + pools.settings.renderThreads + pools.settings.denoiseThreads;
+}
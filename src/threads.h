@@ -0,0 +1,56 @@
+#pragma once
+
+#include "decl.h"
+#include "tbb/tbb.h"
+
+#include <stdint.h>
+
+// Explicit thread pools. Rendering runs in its own task arena of a fixed size instead of the implicit global
+// one, and the denoiser can get a separate arena, so cores can be left to other services on the machine and
+// benchmarks always run on the same threads. With pinning, the threads of each pool are bound to consecutive
+// cores: the render ones first, then the denoise ones, then whatever comes after (the image writers)
+
+struct ThreadSettings
+{
+    uint32_t renderThreads = 0;  // 0 uses all the cores
+    uint32_t denoiseThreads = 0; // 0 denoises in the render arena
+
+    bool pin = false;
+    uint32_t firstCore = 0;
+};
+
+struct PinningObserver;
+
+struct ThreadPools
+{
+    ThreadSettings settings;
+
+    tbb::task_arena render;
+    tbb::task_arena denoise;
+
+    PinningObserver* renderPinning = nullptr;
+    PinningObserver* denoisePinning = nullptr;
+};
+
+void InitThreadPools(ThreadPools& pools, const ThreadSettings& settings) noexcept;
+
+void ReleaseThreadPools(ThreadPools& pools) noexcept;
+
+// First core after the ones of the pools, for the threads pinned outside of them
+uint32_t GetNextFreeCore(const ThreadPools& pools) noexcept;
+
+// Binds the calling thread to a single core, returns false if the platform refused
+bool PinCurrentThread(const uint32_t core) noexcept;
+
+template<typename F>
+FORCEINLINE void RunRender(ThreadPools& pools, const F& function) noexcept
+{
+    pools.render.execute(function);
+}
+
+template<typename F>
+FORCEINLINE void RunDenoise(ThreadPools& pools, const F& function) noexcept
+{
+    if (pools.settings.denoiseThreads > 0) pools.denoise.execute(function);
+    else pools.render.execute(function);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free triple buffer between a single producer and a single consumer. The producer always has a back
+// slot to write to, the consumer always reads the newest published slot, and neither ever waits on the other
+
+template<typename T>
+struct TripleBuffer
+{
+    static constexpr uint8_t indexMask = 0x3;
+    static constexpr uint8_t freshBit = 0x4;
+
+    T slots[3];
+
+    std::atomic<uint8_t> middle{ 1 };
+
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+    // Producer side
+
+    T& GetBack() noexcept { return slots[back]; }
+
+    void Publish() noexcept
+    {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Consumer side, returns true if a newer slot than the current front has been published
+
+    bool Acquire() noexcept
+    {
+        if ((middle.load(std::memory_order_relaxed) & freshBit) == 0) return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+
+        return true;
+    }
+
+    T& GetFront() noexcept { return slots[front]; }
+    const T& GetFront() const noexcept { return slots[front]; }
+};
@@ -0,0 +1,161 @@
+#include "warp.h"
+
+static constexpr uint64_t emptyKey = ~0ull;
+
+FORCEINLINE uint64_t PackKey(const float depth, const uint32_t index) noexcept
+{
+    // Positive floats keep their ordering when compared as integers
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(float));
+
+    return (static_cast<uint64_t>(depthBits) << 32) | index;
+}
+
+FORCEINLINE void AtomicMin(std::atomic<uint64_t>& target, const uint64_t value) noexcept
+{
+    uint64_t current = target.load(std::memory_order_relaxed);
+
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+// Low resolution and low quality render of the current pose for the disoccluded areas. Refreshed every frame so
+// the quality settings and the governor reach it, only a change of size reallocates
+static void UpdateWarp(Warp& warp, const Frame& frame) noexcept
+{
+    const FrameBuffer& source = frame.buffer;
+
+    const uint16_t backgroundXres = maths::max(1.0f, maths::round(source.xres * warp.settings.holeFillScale));
+    const uint16_t backgroundYres = maths::max(1.0f, maths::round(source.yres * warp.settings.holeFillScale));
+
+    warp.backgroundSettings = frame.settings;
+    warp.backgroundSettings.xres = backgroundXres;
+    warp.backgroundSettings.yres = backgroundYres;
+    warp.backgroundSettings.progressive = false;
+    warp.backgroundSettings.region = RenderRegion();
+    warp.backgroundSettings.raymarchOctaves = maths::min(warp.backgroundSettings.raymarchOctaves, 4.0f);
+    warp.backgroundSettings.normalOctaves = maths::min(warp.backgroundSettings.normalOctaves, 8.0f);
+    warp.backgroundSettings.maxMarchSteps = maths::min(warp.backgroundSettings.maxMarchSteps, 60.0f);
+    warp.backgroundSettings.bounces = maths::min(warp.backgroundSettings.bounces, 1.0f);
+
+    if (warp.output.data != nullptr &&
+        warp.output.xres == source.xres &&
+        warp.output.yres == source.yres &&
+        warp.output.format == source.format &&
+        warp.background.xres == backgroundXres &&
+        warp.background.yres == backgroundYres) return;
+
+    AllocateFrameBuffer(warp.output, source.xres, source.yres, source.format);
+
+    delete[] warp.zbuffer;
+    warp.zbuffer = new std::atomic<uint64_t>[source.xres * source.yres];
+
+    AllocateFrameBuffer(warp.background, backgroundXres, backgroundYres, source.format);
+
+    ReleaseTiles(warp.backgroundTiles);
+    GenerateTiles(warp.backgroundTiles, warp.backgroundSettings);
+}
+
+void ReleaseWarp(Warp& warp) noexcept
+{
+    ReleaseFrameBuffer(warp.output);
+    ReleaseFrameBuffer(warp.background);
+    ReleaseTiles(warp.backgroundTiles);
+
+    delete[] warp.zbuffer;
+    warp.zbuffer = nullptr;
+}
+
+void WarpFrame(Warp& warp,
+               const Frame& frame,
+               const Camera& cam,
+               const Ocean& ocean,
+               const Sky& sky,
+               const BlueNoise* blueNoise,
+               const Settings& settings) noexcept
+{
+    UpdateWarp(warp, frame);
+
+    const FrameBuffer& source = frame.buffer;
+    const uint32_t xres = source.xres;
+    const uint32_t yres = source.yres;
+    const size_t pixelSize = GetPixelSize(source.format);
+
+    warp.backgroundSettings.time = settings.time;
+
+    Camera backgroundCam = cam;
+    backgroundCam.aspect = frame.cam.aspect;
+
+    Render(warp.background, ocean, sky, blueNoise, 0, 1, warp.backgroundTiles, backgroundCam, warp.backgroundSettings);
+
+    for (uint32_t i = 0; i < xres * yres; i++) warp.zbuffer[i].store(emptyKey, std::memory_order_relaxed);
+
+    const mat44 inverse = inverse_linear(cam.transformation_matrix);
+
+    // Forward splat of every source pixel to its location in the new view, the closest one wins
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, yres), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (uint32_t x = 0; x < xres; x++)
+                {
+                    const uint32_t index = x + y * xres;
+                    const float depth = frame.depth[index];
+
+                    const vec3 direction = PrimaryDirection(frame.cam, x + 0.5f, y + 0.5f, xres, yres);
+
+                    // The sky only depends on the direction
+                    const vec3 position = depth == maths::constants::inf ? cam.pos + direction * skyDistance :
+                                                                           frame.cam.pos + direction * depth;
+
+                    float px, py;
+
+                    if (!ProjectToScreen(cam, inverse, position, xres, yres, px, py)) continue;
+                    if (px < 0.0f || py < 0.0f || px >= xres || py >= yres) continue;
+
+                    const uint32_t target = static_cast<uint32_t>(px) + static_cast<uint32_t>(py) * xres;
+
+                    AtomicMin(warp.zbuffer[target], PackKey(dist(cam.pos, position), index));
+                }
+            }
+        });
+
+    const uint32_t backgroundXres = warp.background.xres;
+    const uint32_t backgroundYres = warp.background.yres;
+
+    // Gather the winners, fill the cracks from a direct neighbour and the larger holes from the background
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, yres), [&](const tbb::blocked_range<uint32_t>& r)
+        {
+            for (uint32_t y = r.begin(), y_end = r.end(); y < y_end; y++)
+            {
+                for (uint32_t x = 0; x < xres; x++)
+                {
+                    const uint32_t index = x + y * xres;
+
+                    uint64_t key = warp.zbuffer[index].load(std::memory_order_relaxed);
+
+                    if (key == emptyKey)
+                    {
+                        if (x > 0) key = std::min(key, warp.zbuffer[index - 1].load(std::memory_order_relaxed));
+                        if (x + 1 < xres) key = std::min(key, warp.zbuffer[index + 1].load(std::memory_order_relaxed));
+                        if (y > 0) key = std::min(key, warp.zbuffer[index - xres].load(std::memory_order_relaxed));
+                        if (y + 1 < yres) key = std::min(key, warp.zbuffer[index + xres].load(std::memory_order_relaxed));
+                    }
+
+                    uint8_t* dst = static_cast<uint8_t*>(warp.output.data) + index * pixelSize;
+
+                    if (key != emptyKey)
+                    {
+                        const uint32_t sourceIndex = static_cast<uint32_t>(key & 0xFFFFFFFF);
+                        memcpy(dst, static_cast<const uint8_t*>(source.data) + sourceIndex * pixelSize, pixelSize);
+                    }
+                    else
+                    {
+                        const uint32_t bx = std::min(x * backgroundXres / xres, backgroundXres - 1);
+                        const uint32_t by = std::min(y * backgroundYres / yres, backgroundYres - 1);
+
+                        memcpy(dst, static_cast<const uint8_t*>(warp.background.data) + (bx + by * backgroundXres) * pixelSize, pixelSize);
+                    }
+                }
+            }
+        });
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "renderthread.h"
+
+// Display rate frame extrapolation. The last rendered frame is forward reprojected with its depth to the
+// current camera pose, so the view follows the camera input even when the renderer is slow. Holes left
+// by the reprojection are filled with a low resolution render of the current pose
+
+struct WarpSettings
+{
+    bool enabled = false;
+
+    float holeFillScale = 0.125f; // Resolution of the hole filling render relative to the frame
+};
+
+struct Warp
+{
+    WarpSettings settings;
+
+    FrameBuffer output;
+    std::atomic<uint64_t>* zbuffer = nullptr; // Packed depth and source pixel index, for the parallel splat
+
+    FrameBuffer background;
+    Tiles backgroundTiles;
+    Settings backgroundSettings;
+};
+
+void ReleaseWarp(Warp& warp) noexcept;
+
+// Warps the frame to the given camera pose into warp.output, the frame needs its depth plane
+void WarpFrame(Warp& warp,
+               const Frame& frame,
+               const Camera& cam,
+               const Ocean& ocean,
+               const Sky& sky,
+               const BlueNoise* blueNoise,
+               const Settings& settings) noexcept;